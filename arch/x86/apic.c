@@ -0,0 +1,257 @@
+#include "arch/x86/apic.h"
+
+#include <stdint.h>
+
+#include "arch/x86/apic_tables.h"
+#include "arch/x86/cpu.h"
+#include "arch/x86/idt.h"
+#include "arch/x86/irq_controller.h"
+#include "arch/x86/pic.h"
+
+#define IA32_APIC_BASE_MSR 0x1Bu
+#define IA32_APIC_BASE_ENABLE 0x00000800u
+#define IA32_APIC_BASE_ADDR_MASK 0xFFFFF000u
+
+#define LAPIC_REG_ID 0x020u
+#define LAPIC_REG_TPR 0x080u
+#define LAPIC_TPR_CLASS_MASK 0xF0u
+#define LAPIC_REG_EOI 0x0B0u
+#define LAPIC_REG_SVR 0x0F0u
+#define LAPIC_REG_LVT_TIMER 0x320u
+#define LAPIC_REG_LVT_LINT0 0x350u
+#define LAPIC_REG_TIMER_INITIAL 0x380u
+#define LAPIC_REG_TIMER_CURRENT 0x390u
+#define LAPIC_REG_TIMER_DIVIDE 0x3E0u
+#define LAPIC_SVR_ENABLE 0x00000100u
+#define LAPIC_LVT_MASKED 0x00010000u
+#define LAPIC_TIMER_TSC_DEADLINE 0x00040000u
+#define LAPIC_TIMER_DIVIDE_16 0x3u
+
+#define IA32_TSC_DEADLINE_MSR 0x6E0u
+
+#define IOAPIC_REG_SELECT 0x00u
+#define IOAPIC_REG_WINDOW 0x10u
+#define IOAPIC_REG_VERSION 0x01u
+#define IOAPIC_REG_REDIR 0x10u
+#define IOAPIC_REDIR_MASKED 0x00010000u
+#define IOAPIC_REDIR_LEVEL 0x00008000u
+#define IOAPIC_REDIR_ACTIVE_LOW 0x00002000u
+
+#define IRQ_VECTOR_BASE 0x20u
+/* ISA IRQ2 is the 8259 cascade; it never reaches the IO-APIC as a device line. */
+#define ISA_CASCADE_LINE 2u
+
+extern void apic_spurious_stub(void);
+
+/* Bumped by apic_spurious_stub (isr_stubs.asm). */
+volatile uint32_t g_apic_spurious_count;
+
+static volatile uint32_t *g_lapic;
+static int g_apic_active;
+
+/*
+ * Owning IO-APIC, pin and cached low redirection dword per ISA line, so
+ * mask/unmask is a single select+window write pair and never reads back.
+ */
+static volatile uint32_t *g_line_ioapic[IRQ_LINE_COUNT];
+static uint8_t g_line_pin[IRQ_LINE_COUNT];
+static uint32_t g_line_redir[IRQ_LINE_COUNT];
+
+static void lapic_write(uint32_t reg, uint32_t value) {
+    g_lapic[reg / 4u] = value;
+}
+
+static uint32_t lapic_read(uint32_t reg) {
+    return g_lapic[reg / 4u];
+}
+
+static uint32_t ioapic_read(volatile uint32_t *ioapic, uint32_t reg) {
+    ioapic[IOAPIC_REG_SELECT / 4u] = reg;
+    return ioapic[IOAPIC_REG_WINDOW / 4u];
+}
+
+static void ioapic_write(volatile uint32_t *ioapic, uint32_t reg, uint32_t value) {
+    ioapic[IOAPIC_REG_SELECT / 4u] = reg;
+    ioapic[IOAPIC_REG_WINDOW / 4u] = value;
+}
+
+uint32_t apic_ioapic_pin_count(uint32_t ioapic_addr) {
+    volatile uint32_t *ioapic = (volatile uint32_t *)(uintptr_t)ioapic_addr;
+
+    return ((ioapic_read(ioapic, IOAPIC_REG_VERSION) >> 16) & 0xFFu) + 1u;
+}
+
+void apic_send_eoi(void) {
+    lapic_write(LAPIC_REG_EOI, 0u);
+}
+
+static void apic_eoi(uint8_t irq_line) {
+    (void)irq_line;
+    apic_send_eoi();
+}
+
+static void apic_set_line_masked(uint8_t irq_line, int masked) {
+    uint32_t low;
+
+    if (g_line_ioapic[irq_line] == (volatile uint32_t *)0) {
+        return;
+    }
+    if (masked != 0) {
+        low = g_line_redir[irq_line] | IOAPIC_REDIR_MASKED;
+    } else {
+        low = g_line_redir[irq_line] & ~IOAPIC_REDIR_MASKED;
+    }
+    if (low == g_line_redir[irq_line]) {
+        return;
+    }
+    g_line_redir[irq_line] = low;
+    ioapic_write(g_line_ioapic[irq_line], IOAPIC_REG_REDIR + 2u * g_line_pin[irq_line], low);
+}
+
+/*
+ * Nested IRQs: raise the TPR to the vector's priority class so the LAPIC
+ * holds back that class and below until apic_nest_exit(). Masking the
+ * IO-APIC pin instead would lose edges arriving while it is masked.
+ */
+static uint32_t apic_nest_enter(uint8_t irq_line, uint8_t vector) {
+    uint32_t tpr = lapic_read(LAPIC_REG_TPR);
+
+    (void)irq_line;
+    lapic_write(LAPIC_REG_TPR, vector & LAPIC_TPR_CLASS_MASK);
+    return tpr;
+}
+
+static void apic_nest_exit(uint32_t token) {
+    lapic_write(LAPIC_REG_TPR, token);
+}
+
+static void apic_mask(uint8_t irq_line) {
+    apic_set_line_masked(irq_line, 1);
+}
+
+static void apic_unmask(uint8_t irq_line) {
+    apic_set_line_masked(irq_line, 0);
+}
+
+/* IO-APIC lines have no 8259-style spurious IRQ7/15; the LAPIC uses its own vector. */
+const struct irq_controller apic_irq_controller = {
+    "apic",
+    apic_mask,
+    apic_unmask,
+    apic_eoi,
+    (int (*)(uint8_t))0,
+    apic_nest_enter,
+    apic_nest_exit,
+};
+
+/* Resolves each ISA line to an IO-APIC pin. Returns 0 if the timer line has no route. */
+static int apic_resolve_isa_lines(const struct apic_topology *topo) {
+    const struct apic_ioapic_info *info;
+    uint32_t gsi;
+    uint32_t pins;
+    uint32_t low;
+    uint32_t i;
+    uint8_t line;
+
+    for (line = 0u; line < IRQ_LINE_COUNT; ++line) {
+        g_line_ioapic[line] = (volatile uint32_t *)0;
+        if (line == ISA_CASCADE_LINE) {
+            continue;
+        }
+        gsi = topo->isa_gsi[line];
+        for (i = 0u; i < topo->ioapic_count; ++i) {
+            info = &topo->ioapic[i];
+            pins = apic_ioapic_pin_count(info->addr);
+            if (gsi < info->gsi_base || gsi >= info->gsi_base + pins) {
+                continue;
+            }
+
+            /* ISA defaults (flags 0 = conforming) are edge-triggered, active high. */
+            low = IOAPIC_REDIR_MASKED | (line == 0u ? APIC_TICK_VECTOR : IRQ_VECTOR_BASE + line);
+            if ((topo->isa_flags[line] & APIC_INTI_POLARITY_MASK) == APIC_INTI_POLARITY_LOW) {
+                low |= IOAPIC_REDIR_ACTIVE_LOW;
+            }
+            if ((topo->isa_flags[line] & APIC_INTI_TRIGGER_MASK) == APIC_INTI_TRIGGER_LEVEL) {
+                low |= IOAPIC_REDIR_LEVEL;
+            }
+            g_line_ioapic[line] = (volatile uint32_t *)(uintptr_t)info->addr;
+            g_line_pin[line] = (uint8_t)(gsi - info->gsi_base);
+            g_line_redir[line] = low;
+            break;
+        }
+    }
+    return g_line_ioapic[0] != (volatile uint32_t *)0;
+}
+
+int apic_init(void) {
+    struct apic_topology topo;
+    uint64_t base_msr;
+    uint32_t lapic_addr;
+    uint32_t dest;
+    uint8_t line;
+
+    if (cpu_has_feature(CPU_FEATURE_APIC | CPU_FEATURE_MSR) == 0) {
+        return 0;
+    }
+    if (apic_tables_discover(&topo) == 0 || apic_resolve_isa_lines(&topo) == 0) {
+        return 0;
+    }
+
+    base_msr = cpu_rdmsr(IA32_APIC_BASE_MSR);
+    lapic_addr = topo.lapic_addr != 0u ? topo.lapic_addr : (uint32_t)base_msr & IA32_APIC_BASE_ADDR_MASK;
+    base_msr = (base_msr & ~(uint64_t)IA32_APIC_BASE_ADDR_MASK) | (lapic_addr & IA32_APIC_BASE_ADDR_MASK);
+    cpu_wrmsr(IA32_APIC_BASE_MSR, base_msr | IA32_APIC_BASE_ENABLE);
+    g_lapic = (volatile uint32_t *)(uintptr_t)(lapic_addr & IA32_APIC_BASE_ADDR_MASK);
+
+    idt_set_interrupt_gate(APIC_SPURIOUS_VECTOR, apic_spurious_stub);
+    lapic_write(LAPIC_REG_TPR, 0u);
+    /* LINT0 carries the 8259's ExtINT output; the PIC is retired below. */
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+
+    /* Physical destination mode, this CPU only. */
+    dest = lapic_read(LAPIC_REG_ID) & 0xFF000000u;
+    for (line = 0u; line < IRQ_LINE_COUNT; ++line) {
+        if (g_line_ioapic[line] == (volatile uint32_t *)0) {
+            continue;
+        }
+        ioapic_write(g_line_ioapic[line], IOAPIC_REG_REDIR + 2u * g_line_pin[line] + 1u, dest);
+        ioapic_write(g_line_ioapic[line], IOAPIC_REG_REDIR + 2u * g_line_pin[line], g_line_redir[line]);
+    }
+
+    pic_disable();
+    g_apic_active = 1;
+    return 1;
+}
+
+int apic_active(void) {
+    return g_apic_active;
+}
+
+void apic_timer_setup(uint8_t vector, int tsc_deadline) {
+    if (tsc_deadline != 0) {
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | vector);
+        /* The LVT write and the deadline MSR write are not ordered against each other (SDM 10.5.4.1). */
+        __asm__ volatile("mfence" : : : "memory");
+        return;
+    }
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, vector);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0u);
+}
+
+void apic_timer_arm(uint32_t count) {
+    lapic_write(LAPIC_REG_TIMER_INITIAL, count);
+}
+
+void apic_timer_arm_deadline(uint64_t tsc) {
+    cpu_wrmsr(IA32_TSC_DEADLINE_MSR, tsc);
+}
+
+uint32_t apic_timer_current(void) {
+    return lapic_read(LAPIC_REG_TIMER_CURRENT);
+}
+
+uint32_t apic_spurious_count(void) {
+    return g_apic_spurious_count;
+}
@@ -0,0 +1,39 @@
+#ifndef ARCH_X86_APIC_H
+#define ARCH_X86_APIC_H
+
+#include <stdint.h>
+
+/* Low nibble all ones, as older APICs require; the stub only counts and irets. */
+#define APIC_SPURIOUS_VECTOR 0xFFu
+/*
+ * IRQ0 and the LAPIC timer both use this vector under the APIC. Its
+ * priority class (vector >> 4) is above the class-2 ISA vectors 0x21-0x2F,
+ * so with nested IRQs the tick still preempts every other line.
+ */
+#define APIC_TICK_VECTOR 0x30u
+
+/*
+ * Enables the local APIC and routes the ISA IRQs through the IO-APIC (all
+ * masked) using the MADT or MP table, then masks the 8259. Returns 0 and
+ * leaves the PIC in charge if the CPU or firmware has no usable APIC.
+ * Called via irq_controller_init().
+ */
+int apic_init(void);
+int apic_active(void);
+/* EOI for vectors outside the ISA lines (MSI-style sources); ISA lines go through irq_controller. */
+void apic_send_eoi(void);
+
+/*
+ * LAPIC timer on `vector`: one-shot counting down at the bus clock / 16
+ * (apic_timer_arm, 0 stops it), or TSC-deadline mode when `tsc_deadline`
+ * is set (apic_timer_arm_deadline, 0 disarms). Only valid once apic_active().
+ */
+void apic_timer_setup(uint8_t vector, int tsc_deadline);
+void apic_timer_arm(uint32_t count);
+void apic_timer_arm_deadline(uint64_t tsc);
+uint32_t apic_timer_current(void);
+
+uint32_t apic_ioapic_pin_count(uint32_t ioapic_addr);
+uint32_t apic_spurious_count(void);
+
+#endif
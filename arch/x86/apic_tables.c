@@ -0,0 +1,295 @@
+#include "arch/x86/apic_tables.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arch/x86/apic.h"
+#include "kernel/string.h"
+
+/* Firmware tables live in identity-mapped low memory (no paging). */
+#define BDA_EBDA_SEGMENT 0x40Eu
+#define BIOS_ROM_START 0xE0000u
+#define BIOS_ROM_END 0x100000u
+#define BASE_MEMORY_TOP 0xA0000u
+
+#define MADT_LAPIC_ADDR_OVERRIDE_TYPE 5u
+#define MADT_IOAPIC_TYPE 1u
+#define MADT_ISO_TYPE 2u
+
+#define MP_ENTRY_PROCESSOR 0u
+#define MP_ENTRY_BUS 1u
+#define MP_ENTRY_IOAPIC 2u
+#define MP_ENTRY_IO_INTERRUPT 3u
+#define MP_IOAPIC_USABLE 0x01u
+#define MP_INT_TYPE_INT 0u
+
+struct acpi_rsdp {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+} __attribute__((packed));
+
+struct acpi_sdt_header {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+struct acpi_madt {
+    struct acpi_sdt_header header;
+    uint32_t lapic_addr;
+    uint32_t flags;
+} __attribute__((packed));
+
+struct mp_floating_pointer {
+    char signature[4];
+    uint32_t config_table;
+    uint8_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t features[5];
+} __attribute__((packed));
+
+struct mp_config_header {
+    char signature[4];
+    uint16_t base_length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} __attribute__((packed));
+
+static int bytes_sum_zero(const void *data, uint32_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint8_t sum = 0u;
+    uint32_t i;
+
+    for (i = 0u; i < length; ++i) {
+        sum = (uint8_t)(sum + bytes[i]);
+    }
+    return sum == 0u;
+}
+
+static uint32_t ebda_base(void) {
+    const volatile uint16_t *segment = (const volatile uint16_t *)BDA_EBDA_SEGMENT;
+
+    /* Hide the constant from gcc, which assumes nothing valid lives in the zero page. */
+    __asm__("" : "+r"(segment));
+    return (uint32_t)*segment << 4;
+}
+
+/* Scans [start, end) on 16-byte boundaries for a `len`-byte signature. */
+static const void *scan_signature(uint32_t start, uint32_t end, const char *sig, size_t len) {
+    uint32_t addr;
+
+    for (addr = start & ~15u; addr + len <= end; addr += 16u) {
+        if (memcmp((const void *)(uintptr_t)addr, sig, len) == 0) {
+            return (const void *)(uintptr_t)addr;
+        }
+    }
+    return (const void *)0;
+}
+
+static const struct acpi_rsdp *acpi_find_rsdp(void) {
+    const struct acpi_rsdp *rsdp;
+    uint32_t ebda = ebda_base();
+
+    rsdp = (const struct acpi_rsdp *)0;
+    if (ebda >= 0x80000u && ebda < BASE_MEMORY_TOP) {
+        rsdp = (const struct acpi_rsdp *)scan_signature(ebda, ebda + 1024u, "RSD PTR ", 8u);
+    }
+    if (rsdp == (const struct acpi_rsdp *)0) {
+        rsdp = (const struct acpi_rsdp *)scan_signature(BIOS_ROM_START, BIOS_ROM_END, "RSD PTR ", 8u);
+    }
+    if (rsdp == (const struct acpi_rsdp *)0 || bytes_sum_zero(rsdp, sizeof(*rsdp)) == 0) {
+        return (const struct acpi_rsdp *)0;
+    }
+    return rsdp;
+}
+
+/* Only the 32-bit RSDT is walked: without paging, XSDT entries above 4 GiB are unreachable anyway. */
+static const struct acpi_sdt_header *acpi_find_table(const char *signature) {
+    const struct acpi_rsdp *rsdp;
+    const struct acpi_sdt_header *rsdt;
+    const struct acpi_sdt_header *table;
+    const uint32_t *entries;
+    uint32_t count;
+    uint32_t i;
+
+    rsdp = acpi_find_rsdp();
+    if (rsdp == (const struct acpi_rsdp *)0 || rsdp->rsdt_address == 0u) {
+        return (const struct acpi_sdt_header *)0;
+    }
+    rsdt = (const struct acpi_sdt_header *)(uintptr_t)rsdp->rsdt_address;
+    if (memcmp(rsdt->signature, "RSDT", 4u) != 0 || bytes_sum_zero(rsdt, rsdt->length) == 0) {
+        return (const struct acpi_sdt_header *)0;
+    }
+
+    entries = (const uint32_t *)(const void *)(rsdt + 1);
+    count = (rsdt->length - (uint32_t)sizeof(*rsdt)) / 4u;
+    for (i = 0u; i < count; ++i) {
+        table = (const struct acpi_sdt_header *)(uintptr_t)entries[i];
+        if (memcmp(table->signature, signature, 4u) == 0 && bytes_sum_zero(table, table->length) != 0) {
+            return table;
+        }
+    }
+    return (const struct acpi_sdt_header *)0;
+}
+
+static void topology_reset(struct apic_topology *topo) {
+    uint32_t irq;
+
+    topo->lapic_addr = 0u;
+    topo->ioapic_count = 0u;
+    for (irq = 0u; irq < APIC_ISA_IRQS; ++irq) {
+        topo->isa_gsi[irq] = irq;
+        topo->isa_flags[irq] = 0u;
+    }
+}
+
+static void topology_add_ioapic(struct apic_topology *topo, uint8_t id, uint32_t addr, uint32_t gsi_base) {
+    if (topo->ioapic_count >= APIC_MAX_IOAPICS) {
+        return;
+    }
+    topo->ioapic[topo->ioapic_count].id = id;
+    topo->ioapic[topo->ioapic_count].addr = addr;
+    topo->ioapic[topo->ioapic_count].gsi_base = gsi_base;
+    topo->ioapic_count++;
+}
+
+static int parse_madt(struct apic_topology *topo) {
+    const struct acpi_madt *madt;
+    const uint8_t *entry;
+    const uint8_t *end;
+
+    madt = (const struct acpi_madt *)(const void *)acpi_find_table("APIC");
+    if (madt == (const struct acpi_madt *)0) {
+        return 0;
+    }
+
+    topo->lapic_addr = madt->lapic_addr;
+    entry = (const uint8_t *)(madt + 1);
+    end = (const uint8_t *)madt + madt->header.length;
+    while (entry + 2 <= end && entry[1] >= 2u && entry + entry[1] <= end) {
+        switch (entry[0]) {
+        case MADT_IOAPIC_TYPE:
+            /* type, length, id, reserved, addr32, gsi_base32 */
+            topology_add_ioapic(topo, entry[2], *(const uint32_t *)(const void *)(entry + 4),
+                                *(const uint32_t *)(const void *)(entry + 8));
+            break;
+        case MADT_ISO_TYPE:
+            /* type, length, bus, source irq, gsi32, flags16 */
+            if (entry[2] == 0u && entry[3] < APIC_ISA_IRQS) {
+                topo->isa_gsi[entry[3]] = *(const uint32_t *)(const void *)(entry + 4);
+                topo->isa_flags[entry[3]] = *(const uint16_t *)(const void *)(entry + 8);
+            }
+            break;
+        case MADT_LAPIC_ADDR_OVERRIDE_TYPE:
+            /* A 64-bit address; usable only if it sits below 4 GiB. */
+            if (*(const uint32_t *)(const void *)(entry + 8) == 0u) {
+                topo->lapic_addr = *(const uint32_t *)(const void *)(entry + 4);
+            }
+            break;
+        default:
+            break;
+        }
+        entry += entry[1];
+    }
+    return topo->ioapic_count != 0u;
+}
+
+static const struct mp_floating_pointer *mp_find_floating_pointer(void) {
+    const struct mp_floating_pointer *mp;
+    uint32_t ebda = ebda_base();
+
+    mp = (const struct mp_floating_pointer *)0;
+    if (ebda >= 0x80000u && ebda < BASE_MEMORY_TOP) {
+        mp = (const struct mp_floating_pointer *)scan_signature(ebda, ebda + 1024u, "_MP_", 4u);
+    }
+    if (mp == (const struct mp_floating_pointer *)0) {
+        mp = (const struct mp_floating_pointer *)scan_signature(BASE_MEMORY_TOP - 1024u, BASE_MEMORY_TOP, "_MP_", 4u);
+    }
+    if (mp == (const struct mp_floating_pointer *)0) {
+        mp = (const struct mp_floating_pointer *)scan_signature(0xF0000u, BIOS_ROM_END, "_MP_", 4u);
+    }
+    if (mp == (const struct mp_floating_pointer *)0 || bytes_sum_zero(mp, (uint32_t)mp->length * 16u) == 0) {
+        return (const struct mp_floating_pointer *)0;
+    }
+    return mp;
+}
+
+static int parse_mp_table(struct apic_topology *topo) {
+    const struct mp_floating_pointer *mp;
+    const struct mp_config_header *config;
+    const uint8_t *entry;
+    uint32_t gsi_base;
+    uint32_t i;
+    uint32_t j;
+    int isa_bus;
+
+    mp = mp_find_floating_pointer();
+    /* A non-zero feature byte means a default configuration with no table. */
+    if (mp == (const struct mp_floating_pointer *)0 || mp->config_table == 0u || mp->features[0] != 0u) {
+        return 0;
+    }
+    config = (const struct mp_config_header *)(uintptr_t)mp->config_table;
+    if (memcmp(config->signature, "PCMP", 4u) != 0 || bytes_sum_zero(config, config->base_length) == 0) {
+        return 0;
+    }
+
+    topo->lapic_addr = config->lapic_addr;
+    isa_bus = -1;
+    gsi_base = 0u;
+
+    /* Pass 1: buses and IO-APICs. MP numbers IO-APIC pins, so GSIs are assigned in table order. */
+    entry = (const uint8_t *)(config + 1);
+    for (i = 0u; i < config->entry_count; ++i) {
+        if (entry[0] == MP_ENTRY_BUS && memcmp(entry + 2, "ISA", 3u) == 0) {
+            isa_bus = entry[1];
+        } else if (entry[0] == MP_ENTRY_IOAPIC && (entry[3] & MP_IOAPIC_USABLE) != 0u) {
+            topology_add_ioapic(topo, entry[1], *(const uint32_t *)(const void *)(entry + 4), gsi_base);
+            gsi_base += apic_ioapic_pin_count(*(const uint32_t *)(const void *)(entry + 4));
+        }
+        entry += entry[0] == MP_ENTRY_PROCESSOR ? 20u : 8u;
+    }
+
+    /* Pass 2: ISA interrupt assignments (type, int type, flags16, bus, irq, ioapic id, pin). */
+    entry = (const uint8_t *)(config + 1);
+    for (i = 0u; i < config->entry_count; ++i) {
+        if (entry[0] == MP_ENTRY_IO_INTERRUPT && entry[1] == MP_INT_TYPE_INT && (int)entry[4] == isa_bus &&
+            entry[5] < APIC_ISA_IRQS) {
+            for (j = 0u; j < topo->ioapic_count; ++j) {
+                if (topo->ioapic[j].id == entry[6]) {
+                    topo->isa_gsi[entry[5]] = topo->ioapic[j].gsi_base + entry[7];
+                    topo->isa_flags[entry[5]] = *(const uint16_t *)(const void *)(entry + 2);
+                }
+            }
+        }
+        entry += entry[0] == MP_ENTRY_PROCESSOR ? 20u : 8u;
+    }
+    return topo->ioapic_count != 0u;
+}
+
+int apic_tables_discover(struct apic_topology *topo) {
+    topology_reset(topo);
+    if (parse_madt(topo) != 0) {
+        return 1;
+    }
+    topology_reset(topo);
+    return parse_mp_table(topo);
+}
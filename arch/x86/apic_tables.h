@@ -0,0 +1,40 @@
+#ifndef ARCH_X86_APIC_TABLES_H
+#define ARCH_X86_APIC_TABLES_H
+
+#include <stdint.h>
+
+#define APIC_MAX_IOAPICS 4u
+#define APIC_ISA_IRQS 16u
+
+/* MPS INTI flags, shared by MADT overrides and MP interrupt entries. */
+#define APIC_INTI_POLARITY_MASK 0x0003u
+#define APIC_INTI_POLARITY_LOW 0x0003u
+#define APIC_INTI_TRIGGER_MASK 0x000Cu
+#define APIC_INTI_TRIGGER_LEVEL 0x000Cu
+
+struct apic_ioapic_info {
+    uint8_t id;
+    uint32_t addr;
+    uint32_t gsi_base;
+};
+
+/*
+ * What the firmware says about interrupt routing: the local APIC base, the
+ * IO-APICs, and the GSI plus INTI flags each ISA IRQ is wired to (identity
+ * with flags 0 unless overridden).
+ */
+struct apic_topology {
+    uint32_t lapic_addr;
+    uint32_t ioapic_count;
+    struct apic_ioapic_info ioapic[APIC_MAX_IOAPICS];
+    uint32_t isa_gsi[APIC_ISA_IRQS];
+    uint16_t isa_flags[APIC_ISA_IRQS];
+};
+
+/*
+ * Fills `topo` from the ACPI MADT, falling back to the Intel MP
+ * configuration table. Returns 1 if at least one IO-APIC was found.
+ */
+int apic_tables_discover(struct apic_topology *topo);
+
+#endif
@@ -0,0 +1,290 @@
+#include "arch/x86/clockevent.h"
+
+#include <stdint.h>
+
+#include "arch/x86/apic.h"
+#include "arch/x86/cpu.h"
+#include "arch/x86/irqflags.h"
+#include "arch/x86/isr_dispatch.h"
+#include "arch/x86/pit.h"
+#include "arch/x86/tsc.h"
+#include "drivers/vga.h"
+#include "kernel/clock.h"
+#include "kernel/klog.h"
+#include "kernel/softirq.h"
+#include "kernel/timer.h"
+
+#define CLOCKEVENT_IRQ_LINE 0u
+/* The LAPIC timer LVT shares IRQ0's APIC vector, so one handler and one EOI path serve every device. */
+#define CLOCKEVENT_VECTOR APIC_TICK_VECTOR
+#define LAPIC_CALIBRATE_MS 10u
+/* Longest idle sleep when no timer is armed. */
+#define CLOCKEVENT_IDLE_MAX_SECONDS 10u
+#define NSEC_PER_SEC 1000000000u
+
+/* One-shot event source; arm() fires near TSC value `deadline`, clamped to the device's range. */
+struct clockevent_device {
+    const char *name;
+    void (*arm)(uint64_t deadline, uint64_t now);
+};
+
+static const struct clockevent_device *g_device;
+static uint32_t g_tick_hz;
+static uint32_t g_tsc_per_tick;
+static uint64_t g_tsc_base;
+/* TSC value the device was last armed for, and the worst handler delay past it in cycles. */
+static uint64_t g_deadline;
+static uint32_t g_max_lateness;
+static volatile uint32_t g_periodic_ticks;
+static volatile int g_idle;
+static struct timer g_heartbeat;
+/* The VGA/framebuffer commit is the costly part of a tick; it runs after EOI. */
+static struct softirq_work g_frame_work;
+
+/* Slower clock counts per TSC cycle, 0.32 fixed point. */
+static uint32_t g_lapic_per_tsc;
+static uint32_t g_pit_per_tsc;
+
+/* TSC delta to device counts, rounded up so an event never lands before its deadline. */
+static uint32_t tsc_delta_scale(uint64_t deadline, uint64_t now, uint32_t ratio) {
+    uint64_t delta;
+    uint64_t count;
+
+    if (deadline <= now) {
+        return 1u;
+    }
+    delta = deadline - now;
+    if ((delta >> 32) != 0u) {
+        delta = 0xFFFFFFFFu;
+    }
+    count = (((uint64_t)(uint32_t)delta * ratio) >> 32) + 1u;
+    return (count >> 32) != 0u ? 0xFFFFFFFFu : (uint32_t)count;
+}
+
+static void tsc_deadline_arm(uint64_t deadline, uint64_t now) {
+    (void)now;
+    apic_timer_arm_deadline(deadline);
+}
+
+static void lapic_oneshot_arm(uint64_t deadline, uint64_t now) {
+    apic_timer_arm(tsc_delta_scale(deadline, now, g_lapic_per_tsc));
+}
+
+static void pit_oneshot_arm(uint64_t deadline, uint64_t now) {
+    pit_arm_oneshot(tsc_delta_scale(deadline, now, g_pit_per_tsc));
+}
+
+static const struct clockevent_device tsc_deadline_device = {"tsc-deadline", tsc_deadline_arm};
+static const struct clockevent_device lapic_oneshot_device = {"lapic-oneshot", lapic_oneshot_arm};
+static const struct clockevent_device pit_oneshot_device = {"pit-oneshot", pit_oneshot_arm};
+
+/* Counts of the free-running LAPIC timer per TSC cycle over ~10 ms; 0 if it is not slower. */
+static uint32_t lapic_calibrate(uint32_t khz) {
+    uint64_t start;
+    uint64_t cycles;
+    uint32_t counted;
+
+    apic_timer_setup(CLOCKEVENT_VECTOR, 0);
+    start = cpu_rdtsc();
+    apic_timer_arm(0xFFFFFFFFu);
+    do {
+        cycles = cpu_rdtsc() - start;
+    } while (cycles < (uint64_t)khz * LAPIC_CALIBRATE_MS);
+    counted = 0xFFFFFFFFu - apic_timer_current();
+    apic_timer_arm(0u);
+
+    if (counted == 0u || (uint64_t)counted >= cycles || (cycles >> 32) != 0u) {
+        return 0u;
+    }
+    return cpu_div64_32((uint64_t)counted << 32, (uint32_t)cycles, (uint32_t *)0);
+}
+
+static const struct clockevent_device *clockevent_select(uint32_t khz) {
+    if (apic_active() != 0) {
+        if (cpu_has_feature(CPU_FEATURE_TSC_DEADLINE) != 0) {
+            apic_timer_setup(CLOCKEVENT_VECTOR, 1);
+            pit_stop();
+            return &tsc_deadline_device;
+        }
+        g_lapic_per_tsc = lapic_calibrate(khz);
+        if (g_lapic_per_tsc != 0u) {
+            pit_stop();
+            return &lapic_oneshot_device;
+        }
+    }
+    /* 2^32 / 1000 scales PIT_BASE_FREQUENCY_HZ to counts per kHz of TSC in 0.32 fixed point. */
+    g_pit_per_tsc = cpu_div64_32((uint64_t)PIT_BASE_FREQUENCY_HZ * 4294967u, khz, (uint32_t *)0);
+    return &pit_oneshot_device;
+}
+
+/* Tick number at TSC value `now`, with the cycles since that tick's boundary in *phase. */
+static uint32_t tick_at(uint64_t now, uint32_t *phase) {
+    return cpu_div64_32(now - g_tsc_base, g_tsc_per_tick, phase);
+}
+
+/* Arms the next event: the next tick boundary while busy, the earliest timer expiry while idle. */
+static void clockevent_program(uint64_t now, uint32_t tick, uint32_t phase) {
+    uint32_t target;
+    int32_t ahead;
+
+    target = tick + 1u;
+    if (g_idle != 0 && timer_next_expiry(&target) == 0) {
+        target = tick + g_tick_hz * CLOCKEVENT_IDLE_MAX_SECONDS;
+    }
+    ahead = (int32_t)(target - tick);
+    if (ahead < 1) {
+        ahead = 1;
+    }
+    g_deadline = now - phase + (uint64_t)(uint32_t)ahead * g_tsc_per_tick;
+    g_device->arm(g_deadline, now);
+}
+
+static void clockevent_reprogram(void) {
+    uint64_t now = cpu_rdtsc();
+    uint32_t phase;
+    uint32_t tick = tick_at(now, &phase);
+
+    clockevent_program(now, tick, phase);
+}
+
+static void clockevent_heartbeat(struct timer *timer, void *arg) {
+    (void)timer;
+    (void)arg;
+    klog_write(KLOG_INFO, "[pit] heartbeat");
+    isr_report_irq_cost();
+}
+
+static void clockevent_frame_work(void *arg) {
+    (void)arg;
+    vga_frame_tick();
+}
+
+static void clockevent_irq_handler(uint8_t irq_line, const struct isr_frame *frame) {
+    uint64_t now;
+    uint64_t late;
+    uint32_t tick;
+    uint32_t phase;
+
+    (void)irq_line;
+    (void)frame;
+
+    now = 0u;
+    phase = 0u;
+    if (g_device == (const struct clockevent_device *)0) {
+        tick = ++g_periodic_ticks;
+    } else {
+        now = cpu_rdtsc();
+        tick = tick_at(now, &phase);
+        /* An event latched before the last re-arm finds a deadline still ahead; only count real delays. */
+        late = now > g_deadline ? now - g_deadline : 0u;
+        if (late > g_max_lateness) {
+            g_max_lateness = (late >> 32) != 0u ? 0xFFFFFFFFu : (uint32_t)late;
+        }
+    }
+
+    (void)softirq_raise(&g_frame_work);
+    timer_tick(tick);
+
+    if (g_device != (const struct clockevent_device *)0) {
+        clockevent_program(now, tick, phase);
+    }
+}
+
+void clockevent_init(uint32_t hz, int allow_tickless) {
+    const struct clockevent_device *device;
+    uint32_t flags;
+    uint32_t khz;
+
+    if (hz == 0u) {
+        hz = 100u;
+    }
+
+    flags = irq_save_disable();
+    g_device = (const struct clockevent_device *)0;
+    g_tick_hz = hz;
+    g_periodic_ticks = 0u;
+    g_idle = 0;
+    softirq_work_init(&g_frame_work, clockevent_frame_work, (void *)0, SOFTIRQ_PRIO_LOW);
+    isr_register_irq_handler(CLOCKEVENT_IRQ_LINE, clockevent_irq_handler);
+
+    khz = tsc_khz();
+    if (allow_tickless == 0 || khz == 0u) {
+        pit_start_periodic(hz);
+    } else {
+        g_tsc_per_tick = cpu_div64_32((uint64_t)khz * 1000u, hz, (uint32_t *)0);
+        device = clockevent_select(khz);
+        g_tsc_base = cpu_rdtsc();
+        g_device = device;
+        clockevent_reprogram();
+    }
+
+    timer_setup(&g_heartbeat, clockevent_heartbeat, (void *)0);
+    timer_arm(&g_heartbeat, hz, hz);
+    irq_restore(flags);
+}
+
+const char *clockevent_name(void) {
+    return g_device != (const struct clockevent_device *)0 ? g_device->name : "pit-periodic";
+}
+
+uint32_t clockevent_ticks(void) {
+    if (g_device == (const struct clockevent_device *)0) {
+        return g_periodic_ticks;
+    }
+    return tick_at(cpu_rdtsc(), (uint32_t *)0);
+}
+
+uint32_t clockevent_frequency(void) {
+    return g_tick_hz;
+}
+
+uint64_t clockevent_ns_since_tick(uint32_t tick) {
+    uint32_t elapsed;
+    uint32_t phase;
+
+    if (g_device == (const struct clockevent_device *)0) {
+        elapsed = g_periodic_ticks - tick;
+        if (g_tick_hz == 0u || (int32_t)elapsed <= 0) {
+            return 0u;
+        }
+        return (uint64_t)elapsed * (NSEC_PER_SEC / g_tick_hz);
+    }
+    elapsed = tick_at(cpu_rdtsc(), &phase) - tick;
+    if ((int32_t)elapsed < 0) {
+        return 0u;
+    }
+    return clock_cycles_to_ns((uint64_t)elapsed * g_tsc_per_tick + phase);
+}
+
+uint32_t clockevent_take_max_lateness_ns(void) {
+    uint32_t flags = irq_save_disable();
+    uint32_t cycles = g_max_lateness;
+
+    g_max_lateness = 0u;
+    irq_restore(flags);
+    return (uint32_t)clock_cycles_to_ns(cycles);
+}
+
+void clockevent_idle_enter(void) {
+    if (g_device == (const struct clockevent_device *)0) {
+        return;
+    }
+    /* Nothing else commits the screen until the next deadline. */
+    vga_frame_tick();
+    g_idle = 1;
+    clockevent_reprogram();
+}
+
+void clockevent_idle_exit(void) {
+    uint32_t flags;
+
+    if (g_device == (const struct clockevent_device *)0) {
+        return;
+    }
+    flags = irq_save_disable();
+    if (g_idle != 0) {
+        g_idle = 0;
+        clockevent_reprogram();
+    }
+    irq_restore(flags);
+}
@@ -0,0 +1,36 @@
+#ifndef ARCH_X86_CLOCKEVENT_H
+#define ARCH_X86_CLOCKEVENT_H
+
+#include <stdint.h>
+
+/*
+ * Timer tick on IRQ line 0 (vector 0x20, APIC_TICK_VECTOR under the APIC). With a calibrated TSC the tick
+ * is one-shot: the LAPIC timer in TSC-deadline or one-shot mode, or PIT
+ * channel 0 in mode 0. Each event arms the next tick boundary while busy,
+ * or only the earliest kernel/timer.c expiry while idle. Without a TSC, or when
+ * `allow_tickless` is 0, PIT channel 0 runs periodically at `hz` as before.
+ * Call after irq_controller_init() and tsc_init().
+ */
+void clockevent_init(uint32_t hz, int allow_tickless);
+/* "tsc-deadline", "lapic-oneshot", "pit-oneshot" or "pit-periodic". */
+const char *clockevent_name(void);
+
+/* Ticks of 1/hz s since clockevent_init(); derived from the TSC when tickless. */
+uint32_t clockevent_ticks(void);
+uint32_t clockevent_frequency(void);
+/* Time since tick `tick` began (0 if it has not); resolves only whole ticks without a TSC. */
+uint64_t clockevent_ns_since_tick(uint32_t tick);
+/*
+ * Worst delay from an armed one-shot deadline to its handler since the
+ * previous call, then restarts the window. Always 0 with the periodic PIT.
+ */
+uint32_t clockevent_take_max_lateness_ns(void);
+
+/*
+ * Idle loop hooks. idle_enter (interrupts disabled, right before sti; hlt)
+ * flushes the VGA frame and stops the periodic tick; idle_exit restarts it.
+ */
+void clockevent_idle_enter(void);
+void clockevent_idle_exit(void);
+
+#endif
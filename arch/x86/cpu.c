@@ -0,0 +1,123 @@
+#include "arch/x86/cpu.h"
+
+#include <stdint.h>
+
+#define EFLAGS_ID 0x00200000u
+
+#define CR0_MP 0x00000002u
+#define CR0_EM 0x00000004u
+#define CR4_OSFXSR 0x00000200u
+#define CR4_OSXMMEXCPT 0x00000400u
+
+#define CPUID1_EDX_TSC 0x00000010u
+#define CPUID1_EDX_MSR 0x00000020u
+#define CPUID1_EDX_APIC 0x00000200u
+#define CPUID1_EDX_FXSR 0x01000000u
+#define CPUID1_EDX_SSE 0x02000000u
+#define CPUID1_EDX_SSE2 0x04000000u
+#define CPUID1_ECX_TSC_DEADLINE 0x01000000u
+#define CPUID_EXT_MAX_LEAF 0x80000000u
+#define CPUID_EXT_POWER_LEAF 0x80000007u
+#define CPUID_EXT_POWER_EDX_INVARIANT_TSC 0x00000100u
+
+static uint32_t g_cpu_features;
+
+static int cpu_has_cpuid(void) {
+    uint32_t before;
+    uint32_t after;
+
+    __asm__ volatile(
+        "pushfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl %2, %1\n\t"
+        "pushl %1\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %1\n\t"
+        "popfl"
+        : "=&r"(before), "=&r"(after)
+        : "i"(EFLAGS_ID)
+        : "cc");
+    return ((before ^ after) & EFLAGS_ID) != 0u;
+}
+
+void cpu_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+    __asm__ volatile("cpuid"
+                     : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+                     : "a"(leaf), "c"(subleaf));
+}
+
+static void cpu_enable_sse(void) {
+    uint32_t cr0;
+    uint32_t cr4;
+
+    __asm__ volatile("movl %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP;
+    __asm__ volatile("movl %0, %%cr0" : : "r"(cr0) : "memory");
+
+    __asm__ volatile("movl %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    __asm__ volatile("movl %0, %%cr4" : : "r"(cr4) : "memory");
+
+    __asm__ volatile("fninit");
+}
+
+void cpu_init(void) {
+    uint32_t regs[4];
+    uint32_t features;
+
+    features = 0u;
+    if (cpu_has_cpuid() != 0) {
+        features |= CPU_FEATURE_CPUID;
+        cpu_cpuid(0u, 0u, regs);
+        if (regs[0] >= 1u) {
+            cpu_cpuid(1u, 0u, regs);
+            if ((regs[3] & CPUID1_EDX_TSC) != 0u) {
+                features |= CPU_FEATURE_TSC;
+            }
+            if ((regs[3] & CPUID1_EDX_MSR) != 0u) {
+                features |= CPU_FEATURE_MSR;
+            }
+            if ((regs[3] & CPUID1_EDX_APIC) != 0u) {
+                features |= CPU_FEATURE_APIC;
+            }
+            if ((regs[3] & CPUID1_EDX_FXSR) != 0u) {
+                features |= CPU_FEATURE_FXSR;
+            }
+            if ((regs[3] & CPUID1_EDX_SSE) != 0u) {
+                features |= CPU_FEATURE_SSE;
+            }
+            if ((regs[3] & CPUID1_EDX_SSE2) != 0u) {
+                features |= CPU_FEATURE_SSE2;
+            }
+            if ((regs[2] & CPUID1_ECX_TSC_DEADLINE) != 0u) {
+                features |= CPU_FEATURE_TSC_DEADLINE;
+            }
+        }
+        cpu_cpuid(CPUID_EXT_MAX_LEAF, 0u, regs);
+        if (regs[0] >= CPUID_EXT_POWER_LEAF && regs[0] <= CPUID_EXT_MAX_LEAF + 0xFFFFu) {
+            cpu_cpuid(CPUID_EXT_POWER_LEAF, 0u, regs);
+            if ((regs[3] & CPUID_EXT_POWER_EDX_INVARIANT_TSC) != 0u) {
+                features |= CPU_FEATURE_INVARIANT_TSC;
+            }
+        }
+    }
+
+    if ((features & (CPU_FEATURE_FXSR | CPU_FEATURE_SSE)) == (CPU_FEATURE_FXSR | CPU_FEATURE_SSE)) {
+        cpu_enable_sse();
+        features |= CPU_FEATURE_SSE_ENABLED;
+    }
+
+    g_cpu_features = features;
+}
+
+uint32_t cpu_features(void) {
+    return g_cpu_features;
+}
+
+int cpu_has_feature(uint32_t feature) {
+    return (g_cpu_features & feature) == feature;
+}
@@ -0,0 +1,58 @@
+#ifndef ARCH_X86_CPU_H
+#define ARCH_X86_CPU_H
+
+#include <stdint.h>
+
+#define CPU_FEATURE_CPUID 0x00000001u
+#define CPU_FEATURE_TSC 0x00000002u
+#define CPU_FEATURE_MSR 0x00000004u
+#define CPU_FEATURE_APIC 0x00000008u
+#define CPU_FEATURE_FXSR 0x00000010u
+#define CPU_FEATURE_SSE 0x00000020u
+#define CPU_FEATURE_SSE2 0x00000040u
+/* Set once cpu_init() has enabled SSE via CR0/CR4. */
+#define CPU_FEATURE_SSE_ENABLED 0x00000080u
+#define CPU_FEATURE_TSC_DEADLINE 0x00000100u
+/* The TSC ticks at a constant rate across P-/C-states (CPUID 0x80000007 EDX[8]). */
+#define CPU_FEATURE_INVARIANT_TSC 0x00000200u
+
+void cpu_init(void);
+uint32_t cpu_features(void);
+int cpu_has_feature(uint32_t feature);
+void cpu_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]);
+
+/* Only meaningful when CPU_FEATURE_TSC is set. */
+static inline uint64_t cpu_rdtsc(void) {
+    uint32_t lo;
+    uint32_t hi;
+
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Only meaningful when CPU_FEATURE_MSR is set. */
+static inline uint64_t cpu_rdmsr(uint32_t msr) {
+    uint32_t lo;
+    uint32_t hi;
+
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void cpu_wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/* 64/32 division in two divl steps (no libgcc); returns the low 32 bits of the quotient. */
+static inline uint32_t cpu_div64_32(uint64_t num, uint32_t den, uint32_t *rem) {
+    uint32_t quot;
+    uint32_t r = (uint32_t)(num >> 32) % den;
+
+    __asm__("divl %4" : "=a"(quot), "=d"(r) : "0"((uint32_t)num), "1"(r), "rm"(den));
+    if (rem != (uint32_t *)0) {
+        *rem = r;
+    }
+    return quot;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#include "arch/x86/irq_controller.h"
+
+#include <stdint.h>
+
+#include "arch/x86/apic.h"
+#include "arch/x86/irqflags.h"
+
+/* The PIC is live from boot (pic_remap), so it is the initial backend. */
+static const struct irq_controller *g_controller = &pic_irq_controller;
+/* Bit n set: line n is unmasked. Reapplied when the backend changes. */
+static uint16_t g_unmasked;
+
+static void irq_controller_select(const struct irq_controller *controller) {
+    uint32_t flags;
+    uint8_t line;
+
+    flags = irq_save_disable();
+    g_controller = controller;
+    for (line = 0u; line < IRQ_LINE_COUNT; ++line) {
+        if ((g_unmasked & (1u << line)) != 0u) {
+            controller->unmask(line);
+        } else {
+            controller->mask(line);
+        }
+    }
+    irq_restore(flags);
+}
+
+int irq_controller_init(int allow_apic) {
+    if (allow_apic != 0 && apic_init() != 0) {
+        irq_controller_select(&apic_irq_controller);
+        return 1;
+    }
+    irq_controller_select(&pic_irq_controller);
+    return 0;
+}
+
+const struct irq_controller *irq_controller_current(void) {
+    return g_controller;
+}
+
+void irq_mask(uint8_t irq_line) {
+    uint32_t flags;
+
+    if (irq_line >= IRQ_LINE_COUNT) {
+        return;
+    }
+    flags = irq_save_disable();
+    g_unmasked = (uint16_t)(g_unmasked & ~(1u << irq_line));
+    g_controller->mask(irq_line);
+    irq_restore(flags);
+}
+
+void irq_unmask(uint8_t irq_line) {
+    uint32_t flags;
+
+    if (irq_line >= IRQ_LINE_COUNT) {
+        return;
+    }
+    flags = irq_save_disable();
+    g_unmasked = (uint16_t)(g_unmasked | (1u << irq_line));
+    g_controller->unmask(irq_line);
+    irq_restore(flags);
+}
@@ -0,0 +1,43 @@
+#ifndef ARCH_X86_IRQ_CONTROLLER_H
+#define ARCH_X86_IRQ_CONTROLLER_H
+
+#include <stdint.h>
+
+#define IRQ_LINE_COUNT 16u
+
+/*
+ * Interrupt controller backend for the 16 ISA lines (vectors 0x20-0x2F).
+ * isr_common_handler() calls through the selected backend; `is_spurious`
+ * may be NULL when the controller never raises spurious line interrupts.
+ *
+ * `nest_enter` holds back `irq_line` and every line of equal or lower
+ * priority so the handler can run after an early EOI with interrupts
+ * enabled; it returns a token for the matching `nest_exit`. Calls nest
+ * strictly and run with interrupts disabled. Both are NULL when the
+ * backend cannot nest.
+ */
+struct irq_controller {
+    const char *name;
+    void (*mask)(uint8_t irq_line);
+    void (*unmask)(uint8_t irq_line);
+    void (*eoi)(uint8_t irq_line);
+    int (*is_spurious)(uint8_t irq_line);
+    uint32_t (*nest_enter)(uint8_t irq_line, uint8_t vector);
+    void (*nest_exit)(uint32_t token);
+};
+
+extern const struct irq_controller pic_irq_controller;
+extern const struct irq_controller apic_irq_controller;
+
+/*
+ * Picks the backend: the APIC when `allow_apic` is set and apic_init()
+ * succeeds, otherwise the 8259. Lines unmasked so far stay unmasked.
+ * Returns 1 if the APIC is in use.
+ */
+int irq_controller_init(int allow_apic);
+const struct irq_controller *irq_controller_current(void);
+
+void irq_mask(uint8_t irq_line);
+void irq_unmask(uint8_t irq_line);
+
+#endif
@@ -0,0 +1,186 @@
+#include "arch/x86/irq_stats.h"
+
+#include <stdint.h>
+
+#include "arch/x86/apic.h"
+#include "arch/x86/cpu.h"
+#include "arch/x86/irqflags.h"
+#include "arch/x86/isr_dispatch.h"
+#include "arch/x86/keyboard.h"
+#include "drivers/serial.h"
+#include "kernel/clock.h"
+#include "kernel/kprintf.h"
+#include "kernel/softirq.h"
+#include "kernel/timer.h"
+
+#define KEY_F12 0x58u
+
+static struct irq_line_stats g_lines[IRQ_STATS_LINES];
+static struct irq_off_stats g_irqoff;
+/* Start of the current IRQ-off section; 0 when none is being timed. */
+static uint64_t g_irqoff_start;
+static uint32_t g_irqoff_site;
+/* Hotkeys run in the keyboard softirq; the dump itself runs from timer_run() in thread context. */
+static struct timer g_dump_timer;
+
+static uint32_t irq_stats_bucket(uint32_t cycles) {
+    uint32_t bucket;
+
+    if (cycles < (1u << IRQ_STATS_BUCKET_SHIFT)) {
+        return 0u;
+    }
+    bucket = 31u - (uint32_t)__builtin_clz(cycles) - IRQ_STATS_BUCKET_SHIFT;
+    return bucket < IRQ_STATS_BUCKETS ? bucket : IRQ_STATS_BUCKETS - 1u;
+}
+
+void irq_stats_record(uint8_t irq_line, uint32_t cycles) {
+    struct irq_line_stats *line;
+
+    if (irq_line >= IRQ_STATS_LINES) {
+        return;
+    }
+    line = &g_lines[irq_line];
+    line->count++;
+    if (cycles == 0u) {
+        return;
+    }
+    line->total_cycles += cycles;
+    if (cycles > line->max_cycles) {
+        line->max_cycles = cycles;
+    }
+    line->histogram[irq_stats_bucket(cycles)]++;
+}
+
+void irq_stats_spurious(uint8_t irq_line) {
+    if (irq_line < IRQ_STATS_LINES) {
+        g_lines[irq_line].spurious++;
+    }
+}
+
+void irq_stats_irqoff_begin(void) {
+    if (cpu_has_feature(CPU_FEATURE_TSC) == 0) {
+        return;
+    }
+    /* Inlined into the caller of irq_save_disable(), so this names the critical section. */
+    g_irqoff_site = (uint32_t)(uintptr_t)__builtin_return_address(0);
+    g_irqoff_start = cpu_rdtsc();
+}
+
+void irq_stats_irqoff_end(void) {
+    uint64_t cycles;
+
+    if (g_irqoff_start == 0u) {
+        return;
+    }
+    cycles = cpu_rdtsc() - g_irqoff_start;
+    g_irqoff_start = 0u;
+    g_irqoff.sections++;
+    if (cycles > g_irqoff.max_cycles) {
+        g_irqoff.max_cycles = (cycles >> 32) != 0u ? 0xFFFFFFFFu : (uint32_t)cycles;
+        g_irqoff.max_site = g_irqoff_site;
+    }
+}
+
+int irq_stats_get_line(uint8_t irq_line, struct irq_line_stats *stats) {
+    uint32_t flags;
+
+    if (irq_line >= IRQ_STATS_LINES) {
+        return 0;
+    }
+    flags = irq_save_disable();
+    *stats = g_lines[irq_line];
+    irq_restore(flags);
+    return 1;
+}
+
+void irq_stats_get_irqoff(struct irq_off_stats *stats) {
+    uint32_t flags = irq_save_disable();
+
+    *stats = g_irqoff;
+    irq_restore(flags);
+}
+
+static void irq_stats_dump_histogram(const struct irq_line_stats *stats) {
+    char buf[32];
+    uint32_t bucket;
+
+    serial_puts("[irq]   hist");
+    for (bucket = 0u; bucket < IRQ_STATS_BUCKETS; ++bucket) {
+        if (stats->histogram[bucket] == 0u) {
+            continue;
+        }
+        (void)ksnprintf(buf, sizeof(buf), " %u+:%u", bucket == 0u ? 0u : 1u << (bucket + IRQ_STATS_BUCKET_SHIFT),
+                        stats->histogram[bucket]);
+        serial_puts(buf);
+    }
+    serial_puts("\n");
+}
+
+static void irq_stats_dump_softirq(void) {
+    struct softirq_stats stats;
+    char buf[96];
+    uint32_t priority;
+    uint32_t avg;
+
+    for (priority = 0u; priority < SOFTIRQ_PRIORITIES; ++priority) {
+        softirq_get_stats(priority, &stats);
+        if (stats.runs == 0u) {
+            continue;
+        }
+        avg = cpu_div64_32(stats.total_cycles, stats.runs, (uint32_t *)0);
+        (void)ksnprintf(buf, sizeof(buf), "[irq] softirq prio %u: %u runs, avg %u cyc, max %u cyc\n", priority,
+                        stats.runs, avg, stats.max_cycles);
+        serial_puts(buf);
+    }
+}
+
+void irq_stats_dump(void) {
+    struct irq_line_stats stats;
+    struct irq_off_stats off;
+    char buf[128];
+    uint32_t avg;
+    uint8_t line;
+
+    serial_puts("[irq] per-line stats (handler cycles)\n");
+    for (line = 0u; line < IRQ_STATS_LINES; ++line) {
+        (void)irq_stats_get_line(line, &stats);
+        if (stats.count == 0u && stats.spurious == 0u) {
+            continue;
+        }
+        avg = stats.count != 0u ? cpu_div64_32(stats.total_cycles, stats.count, (uint32_t *)0) : 0u;
+        (void)ksnprintf(buf, sizeof(buf), "[irq] line %2u handler %p: %u irqs, %u spurious, avg %u cyc, max %u cyc\n",
+                        line, (const void *)(uintptr_t)isr_get_irq_handler(line), stats.count, stats.spurious, avg,
+                        stats.max_cycles);
+        serial_puts(buf);
+        if (stats.max_cycles != 0u) {
+            irq_stats_dump_histogram(&stats);
+        }
+    }
+    irq_stats_dump_softirq();
+    if (apic_active() != 0) {
+        (void)ksnprintf(buf, sizeof(buf), "[irq] lapic spurious vector: %u\n", apic_spurious_count());
+        serial_puts(buf);
+    }
+
+    irq_stats_get_irqoff(&off);
+    (void)ksnprintf(buf, sizeof(buf), "[irq] irqs-off: %u sections, max %u cyc (%u ns) at %p\n", off.sections,
+                    off.max_cycles, (uint32_t)clock_cycles_to_ns(off.max_cycles),
+                    (const void *)(uintptr_t)off.max_site);
+    serial_puts(buf);
+}
+
+static void irq_stats_dump_expired(struct timer *timer, void *arg) {
+    (void)timer;
+    (void)arg;
+    irq_stats_dump();
+}
+
+static void irq_stats_hotkey(uint16_t key) {
+    (void)key;
+    timer_arm(&g_dump_timer, 0u, 0u);
+}
+
+void irq_stats_init(void) {
+    timer_setup(&g_dump_timer, irq_stats_dump_expired, (void *)0);
+    (void)keyboard_register_hotkey(KEY_F12, 0u, irq_stats_hotkey);
+}
@@ -0,0 +1,57 @@
+#ifndef ARCH_X86_IRQ_STATS_H
+#define ARCH_X86_IRQ_STATS_H
+
+#include <stdint.h>
+
+#define IRQ_STATS_LINES 16u
+/*
+ * Handler-duration histogram: bucket b counts runs of [2^(b + 6), 2^(b + 7))
+ * TSC cycles; bucket 0 also takes shorter runs and the last bucket longer ones.
+ */
+#define IRQ_STATS_BUCKETS 16u
+#define IRQ_STATS_BUCKET_SHIFT 6u
+
+struct irq_line_stats {
+    uint32_t count;
+    /* Rejected by the controller's is_spurious() check; not in `count`. */
+    uint32_t spurious;
+    /*
+     * irq_handler_t cycles only; the dispatch and EOI cost is isr_report_irq_cost()'s.
+     * With nested IRQs this includes handlers that preempted it.
+     */
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint32_t histogram[IRQ_STATS_BUCKETS];
+};
+
+/*
+ * Longest stretch between an irq_save_disable() that turned interrupts off
+ * and the irq_restore() that turned them back on. `max_site` is the return
+ * address of the disabling call, for addr2line. Interrupt gates and bare
+ * cli/sti are not covered; handler time is in struct irq_line_stats.
+ */
+struct irq_off_stats {
+    uint32_t sections;
+    uint32_t max_cycles;
+    uint32_t max_site;
+};
+
+/* Registers the F12 hotkey that dumps everything over serial. */
+void irq_stats_init(void);
+
+/* Called by isr_common_handler(); `cycles` is 0 when there is no TSC. */
+void irq_stats_record(uint8_t irq_line, uint32_t cycles);
+void irq_stats_spurious(uint8_t irq_line);
+
+/* Out-of-line halves of irq_save_disable()/irq_restore(); only called on an IF transition. */
+void irq_stats_irqoff_begin(void);
+void irq_stats_irqoff_end(void);
+
+/* Consistent snapshots (taken with IRQs off); return 0 for an out-of-range line. */
+int irq_stats_get_line(uint8_t irq_line, struct irq_line_stats *stats);
+void irq_stats_get_irqoff(struct irq_off_stats *stats);
+
+/* Writes the per-line table, histograms and IRQ-off maximum to serial. Thread context. */
+void irq_stats_dump(void);
+
+#endif
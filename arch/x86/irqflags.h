@@ -0,0 +1,36 @@
+#ifndef ARCH_X86_IRQFLAGS_H
+#define ARCH_X86_IRQFLAGS_H
+
+#include <stdint.h>
+
+#include "arch/x86/irq_stats.h"
+
+#define EFLAGS_IF 0x00000200u
+
+/* The outermost save/restore pair is timed for the IRQ-off maximum (arch/x86/irq_stats.c). */
+static inline uint32_t irq_save_disable(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    if ((flags & EFLAGS_IF) != 0u) {
+        irq_stats_irqoff_begin();
+    }
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if ((flags & EFLAGS_IF) != 0u) {
+        irq_stats_irqoff_end();
+    }
+    __asm__ volatile("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
+/* Bare sti/cli for paths that know the current state (IRQ exit); not timed. */
+static inline void irq_enable(void) {
+    __asm__ volatile("sti" : : : "memory");
+}
+
+static inline void irq_disable(void) {
+    __asm__ volatile("cli" : : : "memory");
+}
+
+#endif
@@ -2,14 +2,43 @@
 
 #include <stdint.h>
 
-#include "arch/x86/pic.h"
+#include "arch/x86/apic.h"
+#include "arch/x86/cpu.h"
+#include "arch/x86/irq_controller.h"
+#include "arch/x86/irq_stats.h"
+#include "arch/x86/irqflags.h"
 #include "drivers/serial.h"
+#include "drivers/vga.h"
 #include "kernel/fmt.h"
+#include "kernel/klog.h"
+#include "kernel/softirq.h"
+#include "kernel/trace.h"
 
-#define IRQ_VECTOR_BASE 32u
+#define IRQ_VECTOR_BASE ISR_IRQ_VECTOR_FIRST
 #define IRQ_VECTOR_COUNT 16u
+#define VECTOR_WORDS (256u / 32u)
+/*
+ * Handlers deeper than this run with interrupts disabled, so at most
+ * IRQ_NEST_MAX_DEPTH + 1 interrupt frames share the 16 KiB boot stack.
+ */
+#define IRQ_NEST_MAX_DEPTH 4u
 
 static irq_handler_t g_irq_handlers[IRQ_VECTOR_COUNT];
+/* Action chain per vector 32-255; an ISA line's chain sits on ISR_LINE_VECTOR(line). */
+static struct irq_action *g_vector_actions[ISR_IRQ_VECTORS];
+/* Bit n set: vector n is not free for isr_alloc_vector(). Exceptions, ISA lines, the tick and 0xFF start taken. */
+static uint32_t g_vector_used[VECTOR_WORDS] = {0xFFFFFFFFu, 0x0001FFFFu, 0u, 0u, 0u, 0u, 0u, 0x80000000u};
+static int g_irq_nesting;
+/* Handlers in progress; softirqs run only when the outermost one returns. */
+static uint32_t g_irq_depth;
+
+/*
+ * TSC cycles spent in C IRQ dispatch since the last report: the whole
+ * dispatch, and the controller's share of it (spurious check + EOI).
+ */
+static uint32_t g_irq_cost_count;
+static uint32_t g_irq_cost_cycles;
+static uint32_t g_irq_cost_controller_cycles;
 
 static void isr_halt_forever(void) __attribute__((noreturn));
 
@@ -23,99 +52,276 @@ static void isr_halt_forever(void) {
 static void isr_panic(const struct isr_frame *frame) __attribute__((noreturn));
 
 static void isr_panic(const struct isr_frame *frame) {
-    serial_puts("[isr] PANIC exception vector=");
-    put_hex32(frame->vector, serial_puts, serial_putchar);
-    serial_puts(" error=");
-    put_hex32(frame->error_code, serial_puts, serial_putchar);
-    serial_puts(" eip=");
-    put_hex32(frame->eip, serial_puts, serial_putchar);
-    serial_puts(" cs=");
-    put_hex32(frame->cs, serial_puts, serial_putchar);
-    serial_puts(" eflags=");
-    put_hex32(frame->eflags, serial_puts, serial_putchar);
-    serial_puts("\n");
-
-    serial_puts("[isr] regs eax=");
-    put_hex32(frame->eax, serial_puts, serial_putchar);
-    serial_puts(" ebx=");
-    put_hex32(frame->ebx, serial_puts, serial_putchar);
-    serial_puts(" ecx=");
-    put_hex32(frame->ecx, serial_puts, serial_putchar);
-    serial_puts(" edx=");
-    put_hex32(frame->edx, serial_puts, serial_putchar);
-    serial_puts(" esi=");
-    put_hex32(frame->esi, serial_puts, serial_putchar);
-    serial_puts(" edi=");
-    put_hex32(frame->edi, serial_puts, serial_putchar);
-    serial_puts(" ebp=");
-    put_hex32(frame->ebp, serial_puts, serial_putchar);
-    serial_puts("\n");
+    /* IRQs stay off from here on, so emit queued output and bypass the TX ring. */
+    serial_flush_sync();
+    vga_commit();
+    serial_puts_sync("[isr] PANIC exception vector=");
+    put_hex32(frame->vector, serial_puts_sync);
+    serial_puts_sync(" error=");
+    put_hex32(frame->error_code, serial_puts_sync);
+    serial_puts_sync(" eip=");
+    put_hex32(frame->eip, serial_puts_sync);
+    serial_puts_sync(" cs=");
+    put_hex32(frame->cs, serial_puts_sync);
+    serial_puts_sync(" eflags=");
+    put_hex32(frame->eflags, serial_puts_sync);
+    serial_puts_sync("\n");
+
+    serial_puts_sync("[isr] regs eax=");
+    put_hex32(frame->eax, serial_puts_sync);
+    serial_puts_sync(" ebx=");
+    put_hex32(frame->ebx, serial_puts_sync);
+    serial_puts_sync(" ecx=");
+    put_hex32(frame->ecx, serial_puts_sync);
+    serial_puts_sync(" edx=");
+    put_hex32(frame->edx, serial_puts_sync);
+    serial_puts_sync(" esi=");
+    put_hex32(frame->esi, serial_puts_sync);
+    serial_puts_sync(" edi=");
+    put_hex32(frame->edi, serial_puts_sync);
+    serial_puts_sync(" ebp=");
+    put_hex32(frame->ebp, serial_puts_sync);
+    serial_puts_sync("\n");
 
     isr_halt_forever();
 }
 
-static int isr_is_spurious_irq(uint8_t irq_line) {
-    uint16_t isr;
-    uint16_t bit;
+void isr_register_irq_handler(uint8_t irq_line, irq_handler_t handler) {
+    if (irq_line >= IRQ_VECTOR_COUNT) {
+        return;
+    }
+    g_irq_handlers[irq_line] = handler;
+}
+
+void isr_unregister_irq_handler(uint8_t irq_line) {
+    if (irq_line >= IRQ_VECTOR_COUNT) {
+        return;
+    }
+    g_irq_handlers[irq_line] = (irq_handler_t)0;
+}
+
+irq_handler_t isr_get_irq_handler(uint8_t irq_line) {
+    return irq_line < IRQ_VECTOR_COUNT ? g_irq_handlers[irq_line] : (irq_handler_t)0;
+}
+
+void isr_set_irq_nesting(int enabled) {
+    g_irq_nesting = enabled;
+}
 
-    if (irq_line != 7u && irq_line != 15u) {
+int isr_irq_nesting(void) {
+    return g_irq_nesting;
+}
+
+void irq_action_init(struct irq_action *action, irq_action_fn fn, void *arg) {
+    action->next = (struct irq_action *)0;
+    action->fn = fn;
+    action->arg = arg;
+}
+
+int isr_add_action(uint8_t vector, struct irq_action *action) {
+    struct irq_action **link;
+    uint32_t flags;
+
+    if (vector < ISR_IRQ_VECTOR_FIRST) {
         return 0;
     }
+    flags = irq_save_disable();
+    for (link = &g_vector_actions[vector - ISR_IRQ_VECTOR_FIRST]; *link != (struct irq_action *)0;
+         link = &(*link)->next) {
+        if (*link == action) {
+            irq_restore(flags);
+            return 0;
+        }
+    }
+    action->next = (struct irq_action *)0;
+    *link = action;
+    irq_restore(flags);
+    return 1;
+}
 
-    isr = pic_get_isr();
-    bit = (uint16_t)(1u << irq_line);
-    if ((isr & bit) != 0u) {
+int isr_remove_action(uint8_t vector, struct irq_action *action) {
+    struct irq_action **link;
+    uint32_t flags;
+
+    if (vector < ISR_IRQ_VECTOR_FIRST) {
         return 0;
     }
+    flags = irq_save_disable();
+    for (link = &g_vector_actions[vector - ISR_IRQ_VECTOR_FIRST]; *link != (struct irq_action *)0;
+         link = &(*link)->next) {
+        if (*link == action) {
+            *link = action->next;
+            action->next = (struct irq_action *)0;
+            irq_restore(flags);
+            return 1;
+        }
+    }
+    irq_restore(flags);
+    return 0;
+}
 
-    if (irq_line == 15u) {
-        /* Spurious slave IRQ requires EOI on cascade line only. */
-        pic_send_eoi(2u);
+int isr_alloc_vector(uint8_t *vector) {
+    uint32_t flags;
+    uint32_t word;
+    uint32_t bit;
+
+    flags = irq_save_disable();
+    for (word = 0u; word < VECTOR_WORDS; ++word) {
+        if (g_vector_used[word] != 0xFFFFFFFFu) {
+            bit = (uint32_t)__builtin_ctz(~g_vector_used[word]);
+            g_vector_used[word] |= 1u << bit;
+            irq_restore(flags);
+            *vector = (uint8_t)(word * 32u + bit);
+            return 1;
+        }
     }
-    return 1;
+    irq_restore(flags);
+    return 0;
 }
 
-void isr_register_irq_handler(uint8_t irq_line, irq_handler_t handler) {
-    if (irq_line >= IRQ_VECTOR_COUNT) {
+void isr_free_vector(uint8_t vector) {
+    uint32_t flags;
+
+    if (vector <= APIC_TICK_VECTOR || vector == APIC_SPURIOUS_VECTOR) {
         return;
     }
-    g_irq_handlers[irq_line] = handler;
+    flags = irq_save_disable();
+    g_vector_used[vector / 32u] &= ~(1u << (vector % 32u));
+    irq_restore(flags);
 }
 
-void isr_unregister_irq_handler(uint8_t irq_line) {
-    if (irq_line >= IRQ_VECTOR_COUNT) {
-        return;
+/* Runs every action on a chain; O(1) for the usual single handler. */
+static int isr_run_actions(const struct irq_action *action, uint8_t vector, const struct isr_frame *frame) {
+    int handled = IRQ_NONE;
+
+    for (; action != (const struct irq_action *)0; action = action->next) {
+        handled |= action->fn(vector, frame, action->arg);
+    }
+    return handled;
+}
+
+/* Vectors that are not ISA lines: no controller line to mask, so no nesting; EOI goes to the LAPIC. */
+static void isr_dispatch_vector(const struct isr_frame *frame) {
+    uint8_t vector = (uint8_t)frame->vector;
+
+    if (isr_run_actions(g_vector_actions[vector - ISR_IRQ_VECTOR_FIRST], vector, frame) == IRQ_NONE) {
+        klog_write_hex(KLOG_ERROR, "[isr] unhandled vector=", vector, (const char *)0);
+    }
+    if (apic_active() != 0) {
+        apic_send_eoi();
+    }
+    if (g_irq_depth == 0u) {
+        softirq_irq_exit();
     }
-    g_irq_handlers[irq_line] = (irq_handler_t)0;
+}
+
+/* ISA line for an IRQ vector, or IRQ_VECTOR_COUNT if `vector` is not one. */
+static uint8_t isr_vector_line(uint32_t vector) {
+    if (vector >= IRQ_VECTOR_BASE && vector < IRQ_VECTOR_BASE + IRQ_VECTOR_COUNT) {
+        return (uint8_t)(vector - IRQ_VECTOR_BASE);
+    }
+    return vector == APIC_TICK_VECTOR ? 0u : (uint8_t)IRQ_VECTOR_COUNT;
 }
 
 void isr_common_handler(struct isr_frame *frame) {
+    const struct irq_controller *controller;
     uint8_t irq_line;
     irq_handler_t irq_handler;
+    uint64_t start;
+    uint64_t handler_start;
+    uint64_t mark;
+    uint64_t end;
+    uint32_t controller_cycles;
+    uint32_t nest_token;
+    int nested;
+    int timed;
 
     if (frame->vector < IRQ_VECTOR_BASE) {
         isr_panic(frame);
     }
 
-    if (frame->vector >= IRQ_VECTOR_BASE && frame->vector < IRQ_VECTOR_BASE + IRQ_VECTOR_COUNT) {
-        irq_line = (uint8_t)(frame->vector - IRQ_VECTOR_BASE);
-        if (isr_is_spurious_irq(irq_line) != 0) {
-            serial_puts("[isr] spurious irq=");
-            put_hex32(irq_line, serial_puts, serial_putchar);
-            serial_puts("\n");
+    irq_line = isr_vector_line(frame->vector);
+    if (irq_line < IRQ_VECTOR_COUNT) {
+        controller = irq_controller_current();
+        timed = cpu_has_feature(CPU_FEATURE_TSC);
+        start = timed != 0 ? cpu_rdtsc() : 0u;
+        if (controller->is_spurious != (int (*)(uint8_t))0 && controller->is_spurious(irq_line) != 0) {
+            irq_stats_spurious(irq_line);
+            klog_write_hex(KLOG_WARN, "[isr] spurious irq=", irq_line, (const char *)0);
             return;
         }
 
+        /*
+         * Nested: hold back this line and those it outranks, EOI now and run
+         * the handler with interrupts on, so higher-priority lines (the tick
+         * above all) preempt it. The handler's cycles then include theirs.
+         */
+        nested = g_irq_nesting != 0 && g_irq_depth < IRQ_NEST_MAX_DEPTH &&
+                 controller->nest_enter != (uint32_t (*)(uint8_t, uint8_t))0;
+        nest_token = 0u;
+        if (nested != 0) {
+            nest_token = controller->nest_enter(irq_line, (uint8_t)frame->vector);
+            controller->eoi(irq_line);
+        }
+        handler_start = timed != 0 ? cpu_rdtsc() : 0u;
+        controller_cycles = (uint32_t)(handler_start - start);
+
+        trace_irq_enter(irq_line, frame->eip);
         irq_handler = g_irq_handlers[irq_line];
+        g_irq_depth++;
+        if (nested != 0) {
+            irq_enable();
+        }
         if (irq_handler != (irq_handler_t)0) {
             irq_handler(irq_line, frame);
         }
+        if (g_vector_actions[irq_line] != (struct irq_action *)0) {
+            (void)isr_run_actions(g_vector_actions[irq_line], (uint8_t)ISR_LINE_VECTOR(irq_line), frame);
+        }
+        if (nested != 0) {
+            irq_disable();
+        }
+        g_irq_depth--;
 
-        pic_send_eoi(irq_line);
+        mark = timed != 0 ? cpu_rdtsc() : 0u;
+        irq_stats_record(irq_line, (uint32_t)(mark - handler_start));
+        if (nested != 0) {
+            controller->nest_exit(nest_token);
+        } else {
+            controller->eoi(irq_line);
+        }
+        if (timed != 0) {
+            end = cpu_rdtsc();
+            controller_cycles += (uint32_t)(end - mark);
+            g_irq_cost_cycles += (uint32_t)(end - start);
+            g_irq_cost_controller_cycles += controller_cycles;
+            g_irq_cost_count++;
+        }
+        trace_irq_exit(irq_line);
+        if (g_irq_depth == 0u) {
+            softirq_irq_exit();
+        }
         return;
     }
 
-    serial_puts("[isr] unexpected vector=");
-    put_hex32(frame->vector, serial_puts, serial_putchar);
-    serial_puts("\n");
+    isr_dispatch_vector(frame);
+}
+
+/* Logs the average dispatch and controller cost since the previous call, then restarts the window. */
+void isr_report_irq_cost(void) {
+    uint32_t flags = irq_save_disable();
+    uint32_t count = g_irq_cost_count;
+    uint32_t cycles = g_irq_cost_cycles;
+    uint32_t controller_cycles = g_irq_cost_controller_cycles;
+
+    g_irq_cost_count = 0u;
+    g_irq_cost_cycles = 0u;
+    g_irq_cost_controller_cycles = 0u;
+    irq_restore(flags);
+
+    if (count == 0u) {
+        return;
+    }
+    klogf(KLOG_INFO, "[isr] %s: %u irqs, avg %u cyc, ctl %u cyc", irq_controller_current()->name, count,
+          cycles / count, controller_cycles / count);
 }
@@ -26,10 +26,60 @@ struct isr_frame {
     uint32_t eflags;
 };
 
+/* Vectors 32-255 dispatch through isr_common_handler(); the first 16 are the ISA lines. */
+#define ISR_IRQ_VECTOR_FIRST 32u
+#define ISR_IRQ_VECTORS 224u
+#define ISR_LINE_VECTOR(irq_line) (ISR_IRQ_VECTOR_FIRST + (irq_line))
+
+#define IRQ_NONE 0
+#define IRQ_HANDLED 1
+
 typedef void (*irq_handler_t)(uint8_t irq_line, const struct isr_frame *frame);
+/* Returns IRQ_HANDLED if its device raised the interrupt, IRQ_NONE otherwise. */
+typedef int (*irq_action_fn)(uint8_t vector, const struct isr_frame *frame, void *arg);
+
+/*
+ * One handler on a vector that may be shared. Every action on the vector
+ * runs on each interrupt, in the order added, because shared
+ * level-triggered sources can assert together. Storage belongs to the caller.
+ */
+struct irq_action {
+    struct irq_action *next;
+    irq_action_fn fn;
+    void *arg;
+};
 
 void isr_common_handler(struct isr_frame *frame);
 void isr_register_irq_handler(uint8_t irq_line, irq_handler_t handler);
 void isr_unregister_irq_handler(uint8_t irq_line);
+irq_handler_t isr_get_irq_handler(uint8_t irq_line);
+
+void irq_action_init(struct irq_action *action, irq_action_fn fn, void *arg);
+/*
+ * Chains `action` on `vector` (ISR_LINE_VECTOR(line) for an ISA line, where
+ * it runs after the line's irq_handler_t). Returns 0 for an exception vector
+ * or an action already on a chain. Not from a handler on the same vector.
+ */
+int isr_add_action(uint8_t vector, struct irq_action *action);
+int isr_remove_action(uint8_t vector, struct irq_action *action);
+/*
+ * Reserves an unused vector in 0x31-0xFE for an MSI-style source, which is
+ * EOI'd at the LAPIC and runs with interrupts disabled. Returns 0 when all
+ * are taken. The ISA lines, APIC_TICK_VECTOR and the spurious vector are never handed out.
+ */
+int isr_alloc_vector(uint8_t *vector);
+void isr_free_vector(uint8_t vector);
+/*
+ * Nested IRQs (off by default): the controller masks the line and every
+ * lower-priority one, EOIs early, and the handler runs with interrupts
+ * enabled. Handlers must then tolerate being preempted by higher lines.
+ */
+void isr_set_irq_nesting(int enabled);
+int isr_irq_nesting(void);
+/*
+ * klogs the mean TSC cycles per IRQ since the last call, in total and for
+ * the controller (spurious check + EOI); IRQ-safe. Called by the heartbeat timer.
+ */
+void isr_report_irq_cost(void);
 
 #endif
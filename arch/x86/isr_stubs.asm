@@ -18,14 +18,19 @@ isr_stub_\num:
     jmp isr_common_entry
 .endm
 
-.macro IRQ_STUB irq vector
-.global irq_stub_\irq
-irq_stub_\irq:
+/* Stub for a vector of 32-255; `vector` arrives as a number under .altmacro's %expr. */
+.macro IRQ_STUB vector
+.global irq_stub_\vector
+irq_stub_\vector:
     pushl $0
     pushl $\vector
     jmp isr_common_entry
 .endm
 
+.macro IRQ_STUB_ADDR vector
+    .long irq_stub_\vector
+.endm
+
 ISR_NOERR 0
 ISR_NOERR 1
 ISR_NOERR 2
@@ -59,22 +64,20 @@ ISR_ERR   29
 ISR_ERR   30
 ISR_NOERR 31
 
-IRQ_STUB 0,  32
-IRQ_STUB 1,  33
-IRQ_STUB 2,  34
-IRQ_STUB 3,  35
-IRQ_STUB 4,  36
-IRQ_STUB 5,  37
-IRQ_STUB 6,  38
-IRQ_STUB 7,  39
-IRQ_STUB 8,  40
-IRQ_STUB 9,  41
-IRQ_STUB 10, 42
-IRQ_STUB 11, 43
-IRQ_STUB 12, 44
-IRQ_STUB 13, 45
-IRQ_STUB 14, 46
-IRQ_STUB 15, 47
+/* Vectors 32-255: the ISA lines, APIC_TICK_VECTOR and everything isr_alloc_vector() hands out. */
+.altmacro
+.set irq_vector, 32
+.rept 224
+    IRQ_STUB %irq_vector
+    .set irq_vector, irq_vector + 1
+.endr
+.noaltmacro
+
+/* LAPIC spurious vector: no EOI is owed, so count it and return. */
+.global apic_spurious_stub
+apic_spurious_stub:
+    lock incl g_apic_spurious_count
+    iret
 
 .global isr_common_entry
 isr_common_entry:
@@ -140,22 +143,13 @@ g_interrupt_stub_table:
     .long isr_stub_29
     .long isr_stub_30
     .long isr_stub_31
-    .long irq_stub_0
-    .long irq_stub_1
-    .long irq_stub_2
-    .long irq_stub_3
-    .long irq_stub_4
-    .long irq_stub_5
-    .long irq_stub_6
-    .long irq_stub_7
-    .long irq_stub_8
-    .long irq_stub_9
-    .long irq_stub_10
-    .long irq_stub_11
-    .long irq_stub_12
-    .long irq_stub_13
-    .long irq_stub_14
-    .long irq_stub_15
+.altmacro
+.set irq_vector, 32
+.rept 224
+    IRQ_STUB_ADDR %irq_vector
+    .set irq_vector, irq_vector + 1
+.endr
+.noaltmacro
 g_interrupt_stub_table_end:
 
 .section .note.GNU-stack,"",@progbits
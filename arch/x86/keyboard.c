@@ -2,22 +2,73 @@
 
 #include <stdint.h>
 
+#include "arch/x86/irqflags.h"
 #include "arch/x86/isr_dispatch.h"
-#include "drivers/serial.h"
-#include "kernel/fmt.h"
+#include "kernel/klog.h"
+#include "kernel/softirq.h"
+#include "kernel/trace.h"
 
 #define KBD_DATA_PORT 0x60u
 #define KBD_STATUS_PORT 0x64u
 #define KBD_STATUS_OUTPUT_FULL 0x01u
+#define KBD_HOTKEY_MAX 16u
+/*
+ * Both rings are single-producer/single-consumer with free-running
+ * indices, so sizes are powers of two and slots are index & mask.
+ * Raw bytes: IRQ1 -> keyboard softirq. Events: softirq -> thread context.
+ */
+#define KBD_SCANCODE_RING_SIZE 16u
+#define KBD_SCANCODE_RING_MASK (KBD_SCANCODE_RING_SIZE - 1u)
 #define KBD_EVENT_QUEUE_SIZE 64u
-#define KBD_EVENT_VALID 0x40000000u
-#define KBD_EVENT_RELEASE 0x20000000u
-#define KBD_EVENT_EXTENDED 0x10000000u
+#define KBD_EVENT_QUEUE_MASK (KBD_EVENT_QUEUE_SIZE - 1u)
+/* Set-1 make codes covered by the ASCII tables (up to Space). */
+#define KBD_ASCII_CODES 0x3Au
+
+#define SC_LEFT_SHIFT 0x2Au
+#define SC_RIGHT_SHIFT 0x36u
+#define SC_CTRL 0x1Du
+#define SC_ALT 0x38u
+
+_Static_assert((KBD_SCANCODE_RING_SIZE & KBD_SCANCODE_RING_MASK) == 0u, "scancode ring size must be a power of two");
+_Static_assert((KBD_EVENT_QUEUE_SIZE & KBD_EVENT_QUEUE_MASK) == 0u, "event queue size must be a power of two");
+
+struct keyboard_hotkey {
+    uint16_t key;
+    uint8_t modifiers;
+    keyboard_hotkey_fn fn;
+};
 
 static uint8_t g_extended_prefix;
-static volatile uint32_t g_event_head;
-static volatile uint32_t g_event_tail;
+static uint8_t g_modifiers;
+static struct keyboard_hotkey g_hotkeys[KBD_HOTKEY_MAX];
+static uint32_t g_hotkey_count;
+/*
+ * Each index is written only by its own side. A producer fills the slot,
+ * then publishes head with a release store; the consumer's acquire load of
+ * head makes the slot visible, and its release store of tail hands the slot
+ * back. On x86 these are plain movs that the compiler may not reorder.
+ */
+static uint32_t g_event_head;
+static uint32_t g_event_tail;
 static uint32_t g_event_queue[KBD_EVENT_QUEUE_SIZE];
+static uint32_t g_scancode_head;
+static uint32_t g_scancode_tail;
+static uint8_t g_scancode_ring[KBD_SCANCODE_RING_SIZE];
+static struct softirq_work g_keyboard_work;
+
+/* US layout, set-1 make codes 0x00-0x39, without and with Shift. */
+static const char g_ascii_plain[KBD_ASCII_CODES] = {
+    0,   27,  '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', '\b', '\t',
+    'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', '\n', 0,   'a', 's',
+    'd', 'f', 'g', 'h', 'j', 'k', 'l', ';', '\'', '`', 0,   '\\', 'z', 'x', 'c', 'v',
+    'b', 'n', 'm', ',', '.', '/', 0,   '*', 0,   ' ',
+};
+static const char g_ascii_shift[KBD_ASCII_CODES] = {
+    0,   27,  '!', '@', '#', '$', '%', '^', '&', '*', '(', ')', '_', '+', '\b', '\t',
+    'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P', '{', '}', '\n', 0,   'A', 'S',
+    'D', 'F', 'G', 'H', 'J', 'K', 'L', ':', '"', '~', 0,   '|', 'Z', 'X', 'C', 'V',
+    'B', 'N', 'M', '<', '>', '?', 0,   '*', 0,   ' ',
+};
 
 static inline uint8_t inb(uint16_t port) {
     uint8_t value;
@@ -25,90 +76,191 @@ static inline uint8_t inb(uint16_t port) {
     return value;
 }
 
-static inline uint32_t irq_save_disable(void) {
-    uint32_t flags;
-    __asm__ volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
-    return flags;
+/* Producer side, keyboard softirq only. A full ring drops the new event. */
+static void keyboard_enqueue_event(uint32_t event) {
+    uint32_t head = g_event_head;
+    uint32_t tail = __atomic_load_n(&g_event_tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= KBD_EVENT_QUEUE_SIZE) {
+        klog_write_hex(KLOG_WARN, "[kbd] event queue full, dropped event=", event, (const char *)0);
+        return;
+    }
+    g_event_queue[head & KBD_EVENT_QUEUE_MASK] = event;
+    __atomic_store_n(&g_event_head, head + 1u, __ATOMIC_RELEASE);
+    trace_emit(TRACE_EV_KBD_ENQUEUE, event, head + 1u - tail);
 }
 
-static inline void irq_restore(uint32_t flags) {
-    __asm__ volatile("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+/* ASCII for a make code under the current modifiers; Ctrl turns letters into control codes. */
+static uint32_t keyboard_ascii(uint16_t key) {
+    char ch;
+
+    if (key >= KBD_ASCII_CODES) {
+        return 0u;
+    }
+    ch = (g_modifiers & KEYBOARD_MOD_SHIFT) != 0u ? g_ascii_shift[key] : g_ascii_plain[key];
+    if ((g_modifiers & KEYBOARD_MOD_CTRL) != 0u && ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'))) {
+        ch = (char)(ch & 0x1F);
+    }
+    return (uint32_t)(uint8_t)ch;
 }
 
-static void keyboard_enqueue_event(uint32_t event) {
-    uint32_t next_head;
+/* Left and right variants share one bit; E0 1D / E0 38 are right Ctrl / AltGr. */
+static void keyboard_track_modifiers(uint8_t code, int released) {
+    uint8_t bit;
 
-    next_head = (g_event_head + 1u) % KBD_EVENT_QUEUE_SIZE;
-    if (next_head == g_event_tail) {
+    switch (code) {
+    case SC_LEFT_SHIFT:
+    case SC_RIGHT_SHIFT:
+        bit = KEYBOARD_MOD_SHIFT;
+        break;
+    case SC_CTRL:
+        bit = KEYBOARD_MOD_CTRL;
+        break;
+    case SC_ALT:
+        bit = KEYBOARD_MOD_ALT;
+        break;
+    default:
         return;
     }
+    if (released != 0) {
+        g_modifiers = (uint8_t)(g_modifiers & ~bit);
+    } else {
+        g_modifiers = (uint8_t)(g_modifiers | bit);
+    }
+}
 
-    g_event_queue[g_event_head] = event;
-    g_event_head = next_head;
+static int keyboard_dispatch_hotkey(uint16_t key) {
+    uint32_t i;
+
+    for (i = 0u; i < g_hotkey_count; ++i) {
+        if (g_hotkeys[i].key == key && g_hotkeys[i].modifiers == g_modifiers) {
+            g_hotkeys[i].fn(key);
+            return 1;
+        }
+    }
+    return 0;
 }
 
-static void keyboard_irq1_handler(uint8_t irq_line, const struct isr_frame *frame) {
-    uint8_t status;
-    uint8_t scancode;
+/* Decodes one set-1 byte: prefix and modifier tracking, hotkeys, then a finished event for the queue. */
+static void keyboard_process_scancode(uint8_t scancode) {
     uint32_t event;
     uint32_t logged_code;
+    uint16_t key;
 
-    (void)irq_line;
-    (void)frame;
-
-    status = inb(KBD_STATUS_PORT);
-    if ((status & KBD_STATUS_OUTPUT_FULL) == 0u) {
-        return;
-    }
-
-    scancode = inb(KBD_DATA_PORT);
     if (scancode == 0xE0u) {
         g_extended_prefix = 1u;
         return;
     }
 
-    event = KBD_EVENT_VALID | (uint32_t)(scancode & 0x7Fu);
+    event = KEYBOARD_EVENT_VALID;
     logged_code = scancode;
+    key = (uint16_t)(scancode & 0x7Fu);
     if (g_extended_prefix != 0u) {
-        event |= KBD_EVENT_EXTENDED;
+        event |= KEYBOARD_EVENT_EXTENDED;
         logged_code = 0xE000u | (uint32_t)scancode;
+        key |= KEYBOARD_KEY_EXTENDED;
         g_extended_prefix = 0u;
     }
     if ((scancode & 0x80u) != 0u) {
-        event |= KBD_EVENT_RELEASE;
+        event |= KEYBOARD_EVENT_RELEASE;
     }
 
+    keyboard_track_modifiers((uint8_t)(scancode & 0x7Fu), (scancode & 0x80u) != 0u);
+    if ((scancode & 0x80u) == 0u && keyboard_dispatch_hotkey(key) != 0) {
+        return;
+    }
+
+    event |= key | (keyboard_ascii(key) << KEYBOARD_EVENT_ASCII_SHIFT) |
+             ((uint32_t)g_modifiers << KEYBOARD_EVENT_MOD_SHIFT);
     keyboard_enqueue_event(event);
 
-    serial_puts("[kbd] scancode=");
-    put_hex32(logged_code, serial_puts, serial_putchar);
-    if ((scancode & 0x80u) != 0u) {
-        serial_puts(" release");
-    } else {
-        serial_puts(" press");
+    klog_write_hex(KLOG_DEBUG, "[kbd] scancode=", logged_code,
+                   (scancode & 0x80u) != 0u ? " release" : " press");
+}
+
+static void keyboard_softirq(void *arg) {
+    uint32_t head;
+    uint32_t tail;
+
+    (void)arg;
+    head = __atomic_load_n(&g_scancode_head, __ATOMIC_ACQUIRE);
+    for (tail = g_scancode_tail; tail != head; ++tail) {
+        keyboard_process_scancode(g_scancode_ring[tail & KBD_SCANCODE_RING_MASK]);
+    }
+    __atomic_store_n(&g_scancode_tail, tail, __ATOMIC_RELEASE);
+}
+
+/* Top half: acknowledge the controller by reading the byte, queue it, and leave. */
+static void keyboard_irq1_handler(uint8_t irq_line, const struct isr_frame *frame) {
+    uint32_t head;
+    uint8_t scancode;
+
+    (void)irq_line;
+    (void)frame;
+
+    if ((inb(KBD_STATUS_PORT) & KBD_STATUS_OUTPUT_FULL) == 0u) {
+        return;
+    }
+    scancode = inb(KBD_DATA_PORT);
+    head = g_scancode_head;
+    if (head - __atomic_load_n(&g_scancode_tail, __ATOMIC_ACQUIRE) < KBD_SCANCODE_RING_SIZE) {
+        g_scancode_ring[head & KBD_SCANCODE_RING_MASK] = scancode;
+        __atomic_store_n(&g_scancode_head, head + 1u, __ATOMIC_RELEASE);
     }
-    serial_puts("\n");
+    (void)softirq_raise(&g_keyboard_work);
 }
 
 int32_t keyboard_pop_event(void) {
-    uint32_t flags;
     uint32_t event;
 
+    return keyboard_pop_events(&event, 1u) != 0u ? (int32_t)event : 0;
+}
+
+uint32_t keyboard_pop_events(uint32_t *out, uint32_t max) {
+    uint32_t head = __atomic_load_n(&g_event_head, __ATOMIC_ACQUIRE);
+    uint32_t tail = g_event_tail;
+    uint32_t count;
+    uint32_t i;
+
+    count = head - tail < max ? head - tail : max;
+    for (i = 0u; i < count; ++i) {
+        out[i] = g_event_queue[(tail + i) & KBD_EVENT_QUEUE_MASK];
+        trace_emit(TRACE_EV_KBD_DEQUEUE, out[i], head - tail - i - 1u);
+    }
+    __atomic_store_n(&g_event_tail, tail + count, __ATOMIC_RELEASE);
+    return count;
+}
+
+int keyboard_register_hotkey(uint16_t key, uint8_t modifiers, keyboard_hotkey_fn fn) {
+    uint32_t flags;
+
+    if (fn == (keyboard_hotkey_fn)0) {
+        return 0;
+    }
     flags = irq_save_disable();
-    if (g_event_head == g_event_tail) {
+    if (g_hotkey_count >= KBD_HOTKEY_MAX) {
         irq_restore(flags);
         return 0;
     }
-
-    event = g_event_queue[g_event_tail];
-    g_event_tail = (g_event_tail + 1u) % KBD_EVENT_QUEUE_SIZE;
+    g_hotkeys[g_hotkey_count].key = key;
+    g_hotkeys[g_hotkey_count].modifiers = modifiers;
+    g_hotkeys[g_hotkey_count].fn = fn;
+    g_hotkey_count++;
     irq_restore(flags);
-    return (int32_t)event;
+    return 1;
+}
+
+uint8_t keyboard_modifiers(void) {
+    return g_modifiers;
 }
 
 void keyboard_init(void) {
     g_extended_prefix = 0u;
+    g_modifiers = 0u;
     g_event_head = 0u;
     g_event_tail = 0u;
+    g_scancode_head = 0u;
+    g_scancode_tail = 0u;
+    softirq_work_init(&g_keyboard_work, keyboard_softirq, (void *)0, SOFTIRQ_PRIO_HIGH);
     isr_register_irq_handler(1u, keyboard_irq1_handler);
 }
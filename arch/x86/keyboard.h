@@ -3,7 +3,43 @@
 
 #include <stdint.h>
 
+/* Hotkey key codes are set-1 make codes; E0-prefixed keys add KEYBOARD_KEY_EXTENDED. */
+#define KEYBOARD_KEY_EXTENDED 0x100u
+
+#define KEYBOARD_MOD_SHIFT 0x01u
+#define KEYBOARD_MOD_CTRL 0x02u
+#define KEYBOARD_MOD_ALT 0x04u
+
+/*
+ * Key event word, ready to use without further decoding (0 means none):
+ *   bits 0-8    key code: set-1 make code | KEYBOARD_KEY_EXTENDED
+ *   bits 16-23  ASCII for the US layout with Shift/Ctrl applied, 0 if the key has none
+ *   bits 24-26  KEYBOARD_MOD_* held once this event is applied
+ *   bit 28      E0 prefix (as KEYBOARD_KEY_EXTENDED), bit 29 release, bit 30 always set
+ */
+#define KEYBOARD_EVENT_CODE_MASK 0x1FFu
+#define KEYBOARD_EVENT_ASCII_SHIFT 16u
+#define KEYBOARD_EVENT_MOD_SHIFT 24u
+#define KEYBOARD_EVENT_EXTENDED 0x10000000u
+#define KEYBOARD_EVENT_RELEASE 0x20000000u
+#define KEYBOARD_EVENT_VALID 0x40000000u
+
+/*
+ * Runs from the keyboard softirq (after IRQ1's EOI, interrupts enabled) when
+ * `key` is pressed with exactly the registered modifiers held. The press is
+ * consumed (not queued); handlers must be short and IRQ-safe.
+ */
+typedef void (*keyboard_hotkey_fn)(uint16_t key);
+
+int keyboard_register_hotkey(uint16_t key, uint8_t modifiers, keyboard_hotkey_fn fn);
+uint8_t keyboard_modifiers(void);
+/*
+ * Lock-free consumer side of the event ring: one consumer, in thread
+ * context. keyboard_pop_event() returns 0 when empty; keyboard_pop_events()
+ * copies up to `max` events in order and returns how many.
+ */
 int32_t keyboard_pop_event(void);
+uint32_t keyboard_pop_events(uint32_t *out, uint32_t max);
 void keyboard_init(void);
 
 #endif
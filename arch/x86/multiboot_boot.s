@@ -12,6 +12,9 @@
 
 .section .bss
 .align 16
+# Global so kernel/profile.c can bound its frame-pointer walk.
+.global stack_bottom
+.global stack_top
 stack_bottom:
     .skip 16384
 stack_top:
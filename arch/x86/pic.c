@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 
+#include "arch/x86/irq_controller.h"
+
 #define PIC1_COMMAND 0x20u
 #define PIC1_DATA    0x21u
 #define PIC2_COMMAND 0xA0u
@@ -12,6 +14,13 @@
 #define ICW4_8086    0x01u
 #define PIC_READ_ISR 0x0Bu
 
+#define PIC_CASCADE_LINE 2u
+
+/* Shadow of both IMRs (slave in the high byte) so masking is one write, not a read-modify-write. */
+static uint16_t g_pic_mask = 0xFFFFu;
+/* Lines held back by nested handlers in progress; the IMRs hold g_pic_mask | g_pic_nest_block. */
+static uint16_t g_pic_nest_block;
+
 static inline void outb(uint16_t port, uint8_t value) {
     __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
 }
@@ -55,42 +64,45 @@ void pic_remap(uint8_t master_offset, uint8_t slave_offset) {
 
     outb(PIC1_DATA, master_mask);
     outb(PIC2_DATA, slave_mask);
+    g_pic_mask = (uint16_t)((uint16_t)master_mask | (uint16_t)((uint16_t)slave_mask << 8));
 }
 
-void pic_set_mask(uint8_t irq_line) {
-    uint16_t port;
-    uint8_t value;
-    uint8_t bit;
+void pic_disable(void) {
+    g_pic_mask = 0xFFFFu;
+    outb(PIC1_DATA, 0xFFu);
+    outb(PIC2_DATA, 0xFFu);
+}
+
+static void pic_write_mask(uint8_t irq_line) {
+    uint16_t mask = (uint16_t)(g_pic_mask | g_pic_nest_block);
 
     if (irq_line < 8u) {
-        port = PIC1_DATA;
-        bit = irq_line;
+        outb(PIC1_DATA, (uint8_t)(mask & 0xFFu));
     } else {
-        port = PIC2_DATA;
-        bit = (uint8_t)(irq_line - 8u);
+        outb(PIC2_DATA, (uint8_t)(mask >> 8));
     }
-
-    value = inb(port);
-    value = (uint8_t)(value | (uint8_t)(1u << bit));
-    outb(port, value);
 }
 
-void pic_clear_mask(uint8_t irq_line) {
-    uint16_t port;
-    uint8_t value;
-    uint8_t bit;
+/* Writes only the IMRs whose effective mask differs from `previous`. */
+static void pic_write_changed(uint16_t previous) {
+    uint16_t changed = (uint16_t)(previous ^ (g_pic_mask | g_pic_nest_block));
 
-    if (irq_line < 8u) {
-        port = PIC1_DATA;
-        bit = irq_line;
-    } else {
-        port = PIC2_DATA;
-        bit = (uint8_t)(irq_line - 8u);
+    if ((changed & 0x00FFu) != 0u) {
+        pic_write_mask(0u);
     }
+    if ((changed & 0xFF00u) != 0u) {
+        pic_write_mask(8u);
+    }
+}
 
-    value = inb(port);
-    value = (uint8_t)(value & (uint8_t)~(uint8_t)(1u << bit));
-    outb(port, value);
+void pic_set_mask(uint8_t irq_line) {
+    g_pic_mask = (uint16_t)(g_pic_mask | (1u << irq_line));
+    pic_write_mask(irq_line);
+}
+
+void pic_clear_mask(uint8_t irq_line) {
+    g_pic_mask = (uint16_t)(g_pic_mask & ~(1u << irq_line));
+    pic_write_mask(irq_line);
 }
 
 void pic_send_eoi(uint8_t irq_line) {
@@ -110,3 +122,72 @@ uint16_t pic_get_isr(void) {
     slave_isr = inb(PIC2_COMMAND);
     return (uint16_t)((uint16_t)master_isr | (uint16_t)((uint16_t)slave_isr << 8));
 }
+
+/*
+ * IRQ7/IRQ15 can fire without a request in service (a glitch on the line).
+ * Those must not be EOI'd on their own PIC; a spurious slave IRQ still needs
+ * an EOI on the master's cascade line.
+ */
+static int pic_is_spurious(uint8_t irq_line) {
+    uint16_t isr;
+
+    if (irq_line != 7u && irq_line != 15u) {
+        return 0;
+    }
+
+    isr = pic_get_isr();
+    if ((isr & (1u << irq_line)) != 0u) {
+        return 0;
+    }
+
+    if (irq_line == 15u) {
+        pic_send_eoi(2u);
+    }
+    return 1;
+}
+
+/* Fully nested mode priority: 0, 1, then the slave's 8-15 through the cascade, then 3-7. */
+static uint32_t pic_priority_rank(uint8_t irq_line) {
+    if (irq_line < PIC_CASCADE_LINE) {
+        return irq_line;
+    }
+    return irq_line >= 8u ? irq_line - 6u : irq_line + 7u;
+}
+
+/*
+ * Nested IRQs: mask the line and everything it outranks in the IMR. The
+ * 8259 keeps latching edges in the IRR while a line is masked, so nothing
+ * is lost; the cascade stays open for the slave lines that still rank higher.
+ */
+static uint32_t pic_nest_enter(uint8_t irq_line, uint8_t vector) {
+    uint16_t previous = (uint16_t)(g_pic_mask | g_pic_nest_block);
+    uint32_t token = g_pic_nest_block;
+    uint32_t rank = pic_priority_rank(irq_line);
+    uint8_t line;
+
+    (void)vector;
+    for (line = 0u; line < 16u; ++line) {
+        if (line != PIC_CASCADE_LINE && pic_priority_rank(line) >= rank) {
+            g_pic_nest_block = (uint16_t)(g_pic_nest_block | (1u << line));
+        }
+    }
+    pic_write_changed(previous);
+    return token;
+}
+
+static void pic_nest_exit(uint32_t token) {
+    uint16_t previous = (uint16_t)(g_pic_mask | g_pic_nest_block);
+
+    g_pic_nest_block = (uint16_t)token;
+    pic_write_changed(previous);
+}
+
+const struct irq_controller pic_irq_controller = {
+    "pic",
+    pic_set_mask,
+    pic_clear_mask,
+    pic_send_eoi,
+    pic_is_spurious,
+    pic_nest_enter,
+    pic_nest_exit,
+};
@@ -4,6 +4,8 @@
 #include <stdint.h>
 
 void pic_remap(uint8_t master_offset, uint8_t slave_offset);
+/* Masks every line; used when the APIC takes over. */
+void pic_disable(void);
 void pic_set_mask(uint8_t irq_line);
 void pic_clear_mask(uint8_t irq_line);
 void pic_send_eoi(uint8_t irq_line);
@@ -2,25 +2,39 @@
 
 #include <stdint.h>
 
-#include "arch/x86/isr_dispatch.h"
-#include "drivers/serial.h"
+#include "arch/x86/clockevent.h"
 
-#define PIT_BASE_FREQUENCY_HZ 1193182u
 #define PIT_COMMAND_PORT 0x43u
 #define PIT_CHANNEL0_PORT 0x40u
+#define PIT_CHANNEL2_PORT 0x42u
 #define PIT_MODE_RATE_GENERATOR 0x34u
+#define PIT_MODE_ONESHOT 0x30u
+#define PIT_MODE_CH2_ONESHOT 0xB0u
 
-static volatile uint32_t g_pit_ticks;
-static volatile uint32_t g_heartbeat_countdown;
-static volatile uint32_t g_heartbeat_reload;
+/* Port 0x61: bit 0 gates channel 2, bit 1 drives the speaker, bit 5 reads OUT2. */
+#define PIT_GATE_PORT 0x61u
+#define PIT_GATE_CH2 0x01u
+#define PIT_GATE_SPEAKER 0x02u
+#define PIT_GATE_OUT2 0x20u
 
 static inline void outb(uint16_t port, uint8_t value) {
     __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
 }
 
-static void pit_program(uint32_t hz) {
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static void pit_load(uint16_t port, uint8_t mode, uint16_t count) {
+    outb(PIT_COMMAND_PORT, mode);
+    outb(port, (uint8_t)(count & 0xFFu));
+    outb(port, (uint8_t)((count >> 8) & 0xFFu));
+}
+
+void pit_start_periodic(uint32_t hz) {
     uint32_t divisor;
-    uint16_t divisor16;
 
     if (hz == 0u) {
         hz = 100u;
@@ -32,47 +46,43 @@ static void pit_program(uint32_t hz) {
     } else if (divisor > 0xFFFFu) {
         divisor = 0xFFFFu;
     }
-
-    divisor16 = (uint16_t)divisor;
-
-    outb(PIT_COMMAND_PORT, PIT_MODE_RATE_GENERATOR);
-    outb(PIT_CHANNEL0_PORT, (uint8_t)(divisor16 & 0xFFu));
-    outb(PIT_CHANNEL0_PORT, (uint8_t)((divisor16 >> 8) & 0xFFu));
+    pit_load(PIT_CHANNEL0_PORT, PIT_MODE_RATE_GENERATOR, (uint16_t)divisor);
 }
 
-static void pit_irq0_handler(uint8_t irq_line, const struct isr_frame *frame) {
-    (void)irq_line;
-    (void)frame;
-
-    g_pit_ticks++;
-
-    if (g_heartbeat_reload == 0u) {
-        return;
-    }
-
-    if (g_heartbeat_countdown > 0u) {
-        g_heartbeat_countdown--;
+void pit_arm_oneshot(uint32_t count) {
+    if (count == 0u) {
+        count = 1u;
+    } else if (count > 0xFFFFu) {
+        count = 0xFFFFu;
     }
+    /* Mode 0 raises OUT0 (one IRQ0 edge) at terminal count; reloading re-arms it. */
+    pit_load(PIT_CHANNEL0_PORT, PIT_MODE_ONESHOT, (uint16_t)count);
+}
 
-    if (g_heartbeat_countdown == 0u) {
-        serial_puts("[pit] heartbeat\n");
-        g_heartbeat_countdown = g_heartbeat_reload;
-    }
+void pit_stop(void) {
+    /* A mode 0 command without a count holds OUT0 low until a count is written. */
+    outb(PIT_COMMAND_PORT, PIT_MODE_ONESHOT);
 }
 
-void pit_init(uint32_t hz) {
-    if (hz == 0u) {
-        hz = 100u;
-    }
+void pit_ch2_arm(uint16_t count) {
+    uint8_t gate = inb(PIT_GATE_PORT);
 
-    g_pit_ticks = 0u;
-    g_heartbeat_reload = hz;
-    g_heartbeat_countdown = hz;
+    outb(PIT_GATE_PORT, (uint8_t)(gate & ~(PIT_GATE_CH2 | PIT_GATE_SPEAKER)));
+    pit_load(PIT_CHANNEL2_PORT, PIT_MODE_CH2_ONESHOT, count);
+}
+
+void pit_ch2_start(void) {
+    outb(PIT_GATE_PORT, (uint8_t)((inb(PIT_GATE_PORT) & ~PIT_GATE_SPEAKER) | PIT_GATE_CH2));
+}
 
-    pit_program(hz);
-    isr_register_irq_handler(0u, pit_irq0_handler);
+int pit_ch2_expired(void) {
+    return (inb(PIT_GATE_PORT) & PIT_GATE_OUT2) != 0u;
 }
 
 uint32_t pit_get_ticks(void) {
-    return g_pit_ticks;
+    return clockevent_ticks();
+}
+
+uint32_t pit_get_frequency(void) {
+    return clockevent_frequency();
 }
@@ -3,7 +3,24 @@
 
 #include <stdint.h>
 
-void pit_init(uint32_t hz);
+#define PIT_BASE_FREQUENCY_HZ 1193182u
+
+/* Channel 0 (IRQ0): periodic rate generator, single-shot countdown, or stopped. */
+void pit_start_periodic(uint32_t hz);
+/* Counts of 1/PIT_BASE_FREQUENCY_HZ s, clamped to 1..0xFFFF (about 55 ms). */
+void pit_arm_oneshot(uint32_t count);
+void pit_stop(void);
+
+/*
+ * Channel 2 (speaker gate, no IRQ) as a calibration stopwatch: arm loads
+ * `count` with the gate low, start raises the gate, and expired polls OUT2.
+ */
+void pit_ch2_arm(uint16_t count);
+void pit_ch2_start(void);
+int pit_ch2_expired(void);
+
+/* Kept for existing callers: the tick count and rate now come from clockevent. */
 uint32_t pit_get_ticks(void);
+uint32_t pit_get_frequency(void);
 
 #endif
@@ -0,0 +1,64 @@
+#include "arch/x86/tsc.h"
+
+#include <stdint.h>
+
+#include "arch/x86/cpu.h"
+#include "arch/x86/irqflags.h"
+#include "arch/x86/pit.h"
+
+#define TSC_CALIBRATE_ROUNDS 3u
+/* 10 ms of PIT input clock. */
+#define TSC_CALIBRATE_PIT_COUNT (PIT_BASE_FREQUENCY_HZ / 100u)
+/* Far longer than one window; only reached if channel 2 never counts. */
+#define TSC_CALIBRATE_MAX_POLLS 10000000u
+
+static uint32_t g_tsc_khz;
+
+/* TSC cycles for one channel 2 window, or 0 if OUT2 never rose. */
+static uint64_t tsc_measure_window(void) {
+    uint64_t start;
+    uint32_t polls;
+
+    pit_ch2_arm((uint16_t)TSC_CALIBRATE_PIT_COUNT);
+    start = cpu_rdtsc();
+    pit_ch2_start();
+    for (polls = 0u; pit_ch2_expired() == 0; ++polls) {
+        if (polls >= TSC_CALIBRATE_MAX_POLLS) {
+            return 0u;
+        }
+    }
+    return cpu_rdtsc() - start;
+}
+
+int tsc_init(void) {
+    uint64_t best;
+    uint64_t cycles;
+    uint32_t flags;
+    uint32_t round;
+
+    g_tsc_khz = 0u;
+    if (cpu_has_feature(CPU_FEATURE_TSC) == 0) {
+        return 0;
+    }
+
+    /* Interrupts and virtualization exits only ever lengthen a window, so keep the shortest. */
+    best = 0u;
+    flags = irq_save_disable();
+    for (round = 0u; round < TSC_CALIBRATE_ROUNDS; ++round) {
+        cycles = tsc_measure_window();
+        if (cycles != 0u && (best == 0u || cycles < best)) {
+            best = cycles;
+        }
+    }
+    irq_restore(flags);
+    if (best == 0u) {
+        return 0;
+    }
+
+    g_tsc_khz = cpu_div64_32(best * PIT_BASE_FREQUENCY_HZ, TSC_CALIBRATE_PIT_COUNT * 1000u, (uint32_t *)0);
+    return g_tsc_khz != 0u;
+}
+
+uint32_t tsc_khz(void) {
+    return g_tsc_khz;
+}
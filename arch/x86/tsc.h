@@ -0,0 +1,14 @@
+#ifndef ARCH_X86_TSC_H
+#define ARCH_X86_TSC_H
+
+#include <stdint.h>
+
+/*
+ * Measures the TSC rate against PIT channel 2 (best of a few 10 ms
+ * windows, interrupts off). Returns 0 if the CPU has no TSC or the
+ * measurement failed; tsc_khz() then stays 0.
+ */
+int tsc_init(void);
+uint32_t tsc_khz(void);
+
+#endif
@@ -0,0 +1,243 @@
+#include "drivers/fb.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "drivers/font8x8.h"
+#include "kernel/multiboot.h"
+#include "kernel/string.h"
+
+#define VBE_DISPI_INDEX_PORT 0x01CEu
+#define VBE_DISPI_DATA_PORT 0x01CFu
+#define VBE_DISPI_INDEX_ID 0x0u
+#define VBE_DISPI_INDEX_XRES 0x1u
+#define VBE_DISPI_INDEX_YRES 0x2u
+#define VBE_DISPI_INDEX_BPP 0x3u
+#define VBE_DISPI_INDEX_ENABLE 0x4u
+#define VBE_DISPI_ID_32BPP 0xB0C2u
+#define VBE_DISPI_ID_LATEST 0xB0CFu
+#define VBE_DISPI_ENABLED 0x01u
+#define VBE_DISPI_LFB_ENABLED 0x40u
+
+#define PCI_CONFIG_ADDRESS 0xCF8u
+#define PCI_CONFIG_DATA 0xCFCu
+#define PCI_BOCHS_VGA_ID 0x11111234u /* device 0x1111, vendor 0x1234 */
+#define BOCHS_DEFAULT_LFB 0xFD000000u
+
+#define MULTIBOOT_FRAMEBUFFER_TYPE_RGB 1u
+
+#define FB_GLYPH_WIDTH 8u
+#define FB_GLYPH_HEIGHT 16u
+#define FB_COLUMNS 80u
+#define FB_ROWS 25u
+#define FB_MODE_WIDTH (FB_COLUMNS * FB_GLYPH_WIDTH)
+#define FB_MODE_HEIGHT (FB_ROWS * FB_GLYPH_HEIGHT)
+
+/* Direct-mapped cache of glyphs rasterized in a given attribute. */
+#define FB_TILE_CACHE_SIZE 128u
+#define FB_TILE_CACHE_MASK (FB_TILE_CACHE_SIZE - 1u)
+
+struct fb_tile {
+    uint16_t cell;
+    uint16_t valid;
+    uint32_t px[FB_GLYPH_HEIGHT][FB_GLYPH_WIDTH];
+};
+
+static const uint32_t g_palette[16] = {
+    0x000000u, 0x0000AAu, 0x00AA00u, 0x00AAAAu, 0xAA0000u, 0xAA00AAu, 0xAA5500u, 0xAAAAAAu,
+    0x555555u, 0x5555FFu, 0x55FF55u, 0x55FFFFu, 0xFF5555u, 0xFF55FFu, 0xFFFF55u, 0xFFFFFFu,
+};
+
+static struct fb_tile g_tiles[FB_TILE_CACHE_SIZE];
+/* One text row of pixels; each cell is copied in before the next tile lookup can evict it. */
+static uint32_t g_row[FB_GLYPH_HEIGHT][FB_COLUMNS * FB_GLYPH_WIDTH];
+static uint8_t *g_fb_base;
+static uint32_t g_fb_pitch;
+static int g_fb_active;
+
+static inline void outw(uint16_t port, uint16_t value) {
+    __asm__ volatile("outw %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t value;
+    __asm__ volatile("inw %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static inline void outl(uint16_t port, uint32_t value) {
+    __asm__ volatile("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t value;
+    __asm__ volatile("inl %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static void dispi_write(uint16_t index, uint16_t value) {
+    outw(VBE_DISPI_INDEX_PORT, index);
+    outw(VBE_DISPI_DATA_PORT, value);
+}
+
+static uint16_t dispi_read(uint16_t index) {
+    outw(VBE_DISPI_INDEX_PORT, index);
+    return inw(VBE_DISPI_DATA_PORT);
+}
+
+static uint32_t pci_read32(uint32_t bus, uint32_t dev, uint32_t reg) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000u | (bus << 16) | (dev << 11) | (reg & 0xFCu));
+    return inl(PCI_CONFIG_DATA);
+}
+
+/* BAR0 of the Bochs/QEMU std VGA on bus 0 is the LFB; fall back to QEMU's default. */
+static uint32_t bochs_lfb_address(void) {
+    uint32_t dev;
+    uint32_t bar;
+
+    for (dev = 0u; dev < 32u; ++dev) {
+        if (pci_read32(0u, dev, 0x00u) == PCI_BOCHS_VGA_ID) {
+            bar = pci_read32(0u, dev, 0x10u) & 0xFFFFFFF0u;
+            if (bar != 0u) {
+                return bar;
+            }
+        }
+    }
+    return BOCHS_DEFAULT_LFB;
+}
+
+static int fb_init_multiboot(void) {
+    const struct multiboot_info *info = multiboot_get_info();
+
+    if (info == (const struct multiboot_info *)0 || (info->flags & MULTIBOOT_INFO_FRAMEBUFFER) == 0u) {
+        return 0;
+    }
+    if (info->framebuffer_type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB || info->framebuffer_bpp != 32u ||
+        info->framebuffer_addr >= 0x100000000ull || info->framebuffer_width < FB_MODE_WIDTH ||
+        info->framebuffer_height < FB_MODE_HEIGHT) {
+        return 0;
+    }
+
+    g_fb_base = (uint8_t *)(uintptr_t)info->framebuffer_addr;
+    g_fb_pitch = info->framebuffer_pitch;
+    return 1;
+}
+
+static int fb_init_bochs(void) {
+    uint16_t id = dispi_read(VBE_DISPI_INDEX_ID);
+
+    if (id < VBE_DISPI_ID_32BPP || id > VBE_DISPI_ID_LATEST) {
+        return 0;
+    }
+
+    dispi_write(VBE_DISPI_INDEX_ENABLE, 0u);
+    dispi_write(VBE_DISPI_INDEX_XRES, FB_MODE_WIDTH);
+    dispi_write(VBE_DISPI_INDEX_YRES, FB_MODE_HEIGHT);
+    dispi_write(VBE_DISPI_INDEX_BPP, 32u);
+    dispi_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_ENABLED | VBE_DISPI_LFB_ENABLED);
+    if (dispi_read(VBE_DISPI_INDEX_XRES) != FB_MODE_WIDTH || dispi_read(VBE_DISPI_INDEX_BPP) != 32u) {
+        dispi_write(VBE_DISPI_INDEX_ENABLE, 0u);
+        return 0;
+    }
+
+    g_fb_base = (uint8_t *)(uintptr_t)bochs_lfb_address();
+    g_fb_pitch = FB_MODE_WIDTH * 4u;
+    return 1;
+}
+
+int fb_init(void) {
+    uint32_t i;
+
+    if (fb_init_multiboot() == 0 && fb_init_bochs() == 0) {
+        return 0;
+    }
+
+    for (i = 0u; i < FB_TILE_CACHE_SIZE; ++i) {
+        g_tiles[i].valid = 0u;
+    }
+    for (i = 0u; i < FB_MODE_HEIGHT; ++i) {
+        memset(g_fb_base + i * g_fb_pitch, 0, FB_MODE_WIDTH * 4u);
+    }
+    g_fb_active = 1;
+    return 1;
+}
+
+int fb_active(void) {
+    return g_fb_active;
+}
+
+/* Rasterizes the 8x8 font glyph at double height in the cell's colours. */
+static void fb_rasterize(struct fb_tile *tile, uint16_t cell) {
+    static const uint8_t blank[8] = {0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u};
+    const uint8_t *glyph;
+    uint32_t fg;
+    uint32_t bg;
+    uint32_t ch;
+    uint32_t y;
+    uint32_t x;
+    uint8_t bits;
+
+    ch = cell & 0xFFu;
+    fg = g_palette[(cell >> 8) & 0x0Fu];
+    bg = g_palette[(cell >> 12) & 0x0Fu];
+    glyph = ch >= FONT8X8_FIRST && ch <= FONT8X8_LAST ? font8x8_basic[ch - FONT8X8_FIRST] : blank;
+
+    for (y = 0u; y < FB_GLYPH_HEIGHT; ++y) {
+        bits = glyph[y >> 1];
+        for (x = 0u; x < FB_GLYPH_WIDTH; ++x) {
+            tile->px[y][x] = (bits & (1u << x)) != 0u ? fg : bg;
+        }
+    }
+    tile->cell = cell;
+    tile->valid = 1u;
+}
+
+static const struct fb_tile *fb_tile_for(uint16_t cell) {
+    struct fb_tile *tile = &g_tiles[((cell & 0xFFu) ^ ((uint32_t)cell >> 8) * 37u) & FB_TILE_CACHE_MASK];
+
+    if (tile->valid == 0u || tile->cell != cell) {
+        fb_rasterize(tile, cell);
+    }
+    return tile;
+}
+
+/*
+ * Copies each cell's cached tile into the row buffer with 32-bit stores,
+ * then copies the 16 scanlines to the framebuffer with memcpy (SSE2 once
+ * string_init() has enabled it). Cells sharing a cache slot are fine: a
+ * tile is consumed before the next lookup can re-rasterize its slot.
+ */
+void fb_draw_text_row(uint32_t row, const uint16_t *cells, uint32_t count) {
+    const struct fb_tile *tile;
+    uint32_t *dst;
+    uint8_t *line;
+    uint32_t y;
+    uint32_t col;
+
+    if (g_fb_active == 0 || row >= FB_ROWS) {
+        return;
+    }
+    if (count > FB_COLUMNS) {
+        count = FB_COLUMNS;
+    }
+
+    for (col = 0u; col < count; ++col) {
+        tile = fb_tile_for(cells[col]);
+        for (y = 0u; y < FB_GLYPH_HEIGHT; ++y) {
+            dst = &g_row[y][col * FB_GLYPH_WIDTH];
+            dst[0] = tile->px[y][0];
+            dst[1] = tile->px[y][1];
+            dst[2] = tile->px[y][2];
+            dst[3] = tile->px[y][3];
+            dst[4] = tile->px[y][4];
+            dst[5] = tile->px[y][5];
+            dst[6] = tile->px[y][6];
+            dst[7] = tile->px[y][7];
+        }
+    }
+
+    line = g_fb_base + row * FB_GLYPH_HEIGHT * g_fb_pitch;
+    for (y = 0u; y < FB_GLYPH_HEIGHT; ++y, line += g_fb_pitch) {
+        memcpy(line, g_row[y], count * FB_GLYPH_WIDTH * sizeof(g_row[0][0]));
+    }
+}
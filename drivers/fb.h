@@ -0,0 +1,18 @@
+#ifndef DRIVERS_FB_H
+#define DRIVERS_FB_H
+
+#include <stdint.h>
+
+/*
+ * 32 bpp linear framebuffer text renderer. fb_init() takes a Multiboot RGB
+ * framebuffer when the loader provides one, otherwise programs the Bochs/QEMU
+ * VBE dispi interface (`-vga std`) for 640x400. Returns 1 when a framebuffer
+ * is ready, 0 otherwise.
+ */
+int fb_init(void);
+int fb_active(void);
+
+/* Draws text row `row` from VGA-style cells (char | attr << 8). */
+void fb_draw_text_row(uint32_t row, const uint16_t *cells, uint32_t count);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef DRIVERS_FONT8X8_H
+#define DRIVERS_FONT8X8_H
+
+#include <stdint.h>
+
+#define FONT8X8_FIRST 0x20u
+#define FONT8X8_LAST 0x7Eu
+
+/*
+ * Public-domain 8x8 bitmap font for printable ASCII (IBM PC BIOS shapes).
+ * One byte per scanline, bit 0 is the leftmost pixel.
+ */
+extern const uint8_t font8x8_basic[FONT8X8_LAST - FONT8X8_FIRST + 1u][8];
+
+#endif
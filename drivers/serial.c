@@ -1,6 +1,32 @@
+#include "drivers/serial.h"
+
+#include <stddef.h>
 #include <stdint.h>
 
+#include "arch/x86/irqflags.h"
+#include "arch/x86/isr_dispatch.h"
+#include "kernel/string.h"
+
 #define COM1 0x3F8
+#define COM1_IRQ 4u
+
+#define SERIAL_IER_THRE 0x02u
+#define SERIAL_LSR_THRE 0x20u
+#define SERIAL_FIFO_DEPTH 16u
+
+/*
+ * Transmit ring. Producers copy into it with IRQs briefly disabled; the IRQ4
+ * handler refills the 16-byte FIFO each time it drains. Indices run freely
+ * and are masked on access, so the size must be a power of two.
+ */
+#define SERIAL_TX_RING_SIZE 4096u
+#define SERIAL_TX_RING_MASK (SERIAL_TX_RING_SIZE - 1u)
+
+static uint8_t g_tx_ring[SERIAL_TX_RING_SIZE];
+static uint32_t g_tx_head;
+static uint32_t g_tx_tail;
+static int g_tx_irq_mode;
+static int g_tx_irq_armed;
 
 static inline void outb(uint16_t port, uint8_t value) {
     __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
@@ -19,25 +45,173 @@ void serial_init(void) {
     outb(COM1 + 1, 0x00);  /* Divisor high byte */
     outb(COM1 + 3, 0x03);  /* 8 bits, no parity, one stop bit */
     outb(COM1 + 2, 0xC7);  /* Enable FIFO, clear, 14-byte threshold */
-    outb(COM1 + 4, 0x0B);  /* IRQs disabled, RTS/DSR set */
+    outb(COM1 + 4, 0x0B);  /* DTR, RTS, OUT2 (gates the IRQ line) */
+
+    g_tx_head = 0u;
+    g_tx_tail = 0u;
+    g_tx_irq_mode = 0;
+    g_tx_irq_armed = 0;
 }
 
 static int serial_can_transmit(void) {
-    return (inb(COM1 + 5) & 0x20) != 0;
+    return (inb(COM1 + 5) & SERIAL_LSR_THRE) != 0;
+}
+
+/* Moves up to one FIFO's worth of ring bytes to the UART. Caller holds IRQs off. */
+static void serial_tx_fill_fifo(void) {
+    uint32_t count = 0u;
+
+    while (g_tx_tail != g_tx_head && count < SERIAL_FIFO_DEPTH) {
+        outb(COM1, g_tx_ring[g_tx_tail & SERIAL_TX_RING_MASK]);
+        g_tx_tail++;
+        count++;
+    }
+}
+
+static void serial_tx_set_armed(int armed) {
+    if (armed == g_tx_irq_armed) {
+        return;
+    }
+    g_tx_irq_armed = armed;
+    outb(COM1 + 1, armed != 0 ? SERIAL_IER_THRE : 0x00u);
+}
+
+/* Busy-waits the ring down to empty. Works with IRQs disabled. */
+static void serial_tx_drain_sync(void) {
+    while (g_tx_tail != g_tx_head) {
+        while (!serial_can_transmit()) {
+        }
+        serial_tx_fill_fifo();
+    }
+}
+
+static void serial_irq4_handler(uint8_t irq_line, const struct isr_frame *frame) {
+    (void)irq_line;
+    (void)frame;
+
+    /* Reading IIR acknowledges a pending THRE interrupt. */
+    (void)inb(COM1 + 2);
+    if (g_tx_irq_armed == 0) {
+        return;
+    }
+
+    if (serial_can_transmit()) {
+        serial_tx_fill_fifo();
+    }
+    if (g_tx_tail == g_tx_head) {
+        serial_tx_set_armed(0);
+    }
+}
+
+static void serial_tx_push(const uint8_t *buf, size_t len) {
+    uint32_t flags;
+    uint32_t room;
+    uint32_t offset;
+    uint32_t chunk;
+
+    flags = irq_save_disable();
+    while (len > 0u) {
+        room = SERIAL_TX_RING_SIZE - (g_tx_head - g_tx_tail);
+        if (room == 0u) {
+            /* Ring full: make room synchronously rather than drop output. */
+            while (!serial_can_transmit()) {
+            }
+            serial_tx_fill_fifo();
+            continue;
+        }
+
+        offset = g_tx_head & SERIAL_TX_RING_MASK;
+        chunk = SERIAL_TX_RING_SIZE - offset;
+        if (chunk > room) {
+            chunk = room;
+        }
+        if (chunk > len) {
+            chunk = (uint32_t)len;
+        }
+
+        memcpy(&g_tx_ring[offset], buf, chunk);
+        g_tx_head += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+
+    if (g_tx_irq_mode == 0) {
+        serial_tx_drain_sync();
+    } else if (g_tx_irq_armed == 0) {
+        if (serial_can_transmit()) {
+            serial_tx_fill_fifo();
+        }
+        serial_tx_set_armed(1);
+    }
+    irq_restore(flags);
+}
+
+void serial_enable_tx_irq(void) {
+    uint32_t flags;
+
+    isr_register_irq_handler(COM1_IRQ, serial_irq4_handler);
+
+    flags = irq_save_disable();
+    g_tx_irq_mode = 1;
+    if (g_tx_tail != g_tx_head) {
+        serial_tx_set_armed(1);
+    }
+    irq_restore(flags);
+}
+
+void serial_flush_sync(void) {
+    uint32_t flags;
+
+    flags = irq_save_disable();
+    serial_tx_drain_sync();
+    irq_restore(flags);
 }
 
 void serial_putchar(char ch) {
+    uint8_t byte = (uint8_t)ch;
+
+    serial_tx_push(&byte, 1u);
+}
+
+void serial_write_raw(const void *buf, size_t len) {
+    if (len != 0u) {
+        serial_tx_push((const uint8_t *)buf, len);
+    }
+}
+
+void serial_write(const void *buf, size_t len) {
+    static const uint8_t crlf[2] = {'\r', '\n'};
+    const uint8_t *bytes = (const uint8_t *)buf;
+    const uint8_t *start = bytes;
+    const uint8_t *end = bytes + len;
+
+    /* Push runs between newlines in one go; only '\n' itself is expanded. */
+    for (; bytes != end; ++bytes) {
+        if (*bytes == '\n') {
+            serial_write_raw(start, (size_t)(bytes - start));
+            serial_tx_push(crlf, sizeof(crlf));
+            start = bytes + 1;
+        }
+    }
+    serial_write_raw(start, (size_t)(end - start));
+}
+
+void serial_puts(const char *str) {
+    serial_write(str, strlen(str));
+}
+
+void serial_putchar_sync(char ch) {
     while (!serial_can_transmit()) {
     }
     outb(COM1, (uint8_t)ch);
 }
 
-void serial_puts(const char *str) {
+void serial_puts_sync(const char *str) {
     while (*str != '\0') {
         if (*str == '\n') {
-            serial_putchar('\r');
+            serial_putchar_sync('\r');
         }
-        serial_putchar(*str);
+        serial_putchar_sync(*str);
         ++str;
     }
 }
@@ -1,8 +1,27 @@
 #ifndef DRIVERS_SERIAL_H
 #define DRIVERS_SERIAL_H
 
+#include <stddef.h>
+
 void serial_init(void);
 void serial_putchar(char ch);
 void serial_puts(const char *str);
 
+/* Bulk output: copies `len` bytes into the TX ring in as few pushes as possible. */
+void serial_write(const void *buf, size_t len);   /* '\n' becomes CRLF */
+void serial_write_raw(const void *buf, size_t len);  /* bytes sent verbatim */
+
+/*
+ * Switches transmit from synchronous draining to the IRQ4-driven ring.
+ * Requires the IDT and PIC to be set up; IRQ4 must be unmasked by the caller.
+ */
+void serial_enable_tx_irq(void);
+
+/* Busy-waits until every queued byte has been handed to the UART. */
+void serial_flush_sync(void);
+
+/* Bypass the ring entirely; for panic paths. Call serial_flush_sync() first to keep ordering. */
+void serial_putchar_sync(char ch);
+void serial_puts_sync(const char *str);
+
 #endif
@@ -1,82 +1,395 @@
+#include "drivers/vga.h"
+
 #include <stdint.h>
 #include <stddef.h>
 
+#include "arch/x86/irqflags.h"
+#include "arch/x86/keyboard.h"
+#include "drivers/fb.h"
+#include "kernel/string.h"
+
+#define VGA_CRTC_INDEX 0x3D4u
+#define VGA_CRTC_DATA 0x3D5u
+#define VGA_CRTC_START_HIGH 0x0Cu
+#define VGA_CRTC_START_LOW 0x0Du
+#define VGA_CRTC_CURSOR_HIGH 0x0Eu
+#define VGA_CRTC_CURSOR_LOW 0x0Fu
+
+#define VGA_BLANK_ATTR 0x07u
+
+/* Set-1 make codes for the console hotkeys. */
+#define KEY_F1 0x3Bu
+#define KEY_PAGE_UP (KEYBOARD_KEY_EXTENDED | 0x49u)
+#define KEY_PAGE_DOWN (KEYBOARD_KEY_EXTENDED | 0x51u)
+
 enum {
     VGA_WIDTH = 80,
     VGA_HEIGHT = 25,
     VGA_SIZE = VGA_WIDTH * VGA_HEIGHT,
+    /* The 32 KiB colour text window at 0xB8000 holds 204 full rows. */
+    VGA_VRAM_ROWS = 0x8000 / (VGA_WIDTH * 2),
+    /* Per-console ring: the visible screen plus scrollback. */
+    VGA_CONSOLE_ROWS = 128,
+    VGA_SCROLLBACK_ROWS = VGA_CONSOLE_ROWS - VGA_HEIGHT,
+};
+
+#define VGA_ALL_ROWS_DIRTY ((1u << VGA_HEIGHT) - 1u)
+
+/*
+ * Each virtual console owns a ring of rows. Screen row 0 lives at ring row
+ * `head`, the `history` rows before it are scrollback, and `view` is how far
+ * the display is scrolled back into them (0 = following output).
+ */
+struct vga_console {
+    uint16_t rows[VGA_CONSOLE_ROWS][VGA_WIDTH];
+    size_t head;
+    size_t history;
+    size_t view;
+    size_t cursor_row;
+    size_t cursor_col;
 };
 
 static volatile uint16_t *const vga_hw = (volatile uint16_t *)0xB8000;
-static uint16_t shadow[VGA_WIDTH * VGA_HEIGHT];
-static size_t cursor_row = 0;
-static size_t cursor_col = 0;
+
+/*
+ * All writes land in console memory only; vga_commit() copies the active
+ * console's dirty rows to the device and batches the CRTC start-address and
+ * cursor updates. Background consoles never touch MMIO.
+ */
+static struct vga_console consoles[VGA_CONSOLE_COUNT];
+static struct vga_console *active = &consoles[0];
+/* Bit n set: screen row n differs from what the device shows. */
+static uint32_t dirty_rows = VGA_ALL_ROWS_DIRTY;
+/* VRAM row shown at the top of the screen (hardware scroll mode only). */
+static size_t vram_origin = 0;
+static int scroll_mode = VGA_SCROLL_HARDWARE;
+/* Rows are rendered to the linear framebuffer instead of text VRAM. */
+static int use_framebuffer = 0;
+static uint8_t write_attr = VGA_ATTR_DEFAULT;
+
+/* Requests from the keyboard IRQ, applied by the next commit. */
+static volatile int pending_console = 0;
+static volatile int32_t pending_view_delta = 0;
+
+/* Last values written to the CRTC; 0xFFFF forces the first commit to program them. */
+static uint16_t hw_start = 0xFFFFu;
+static uint16_t hw_cursor = 0xFFFFu;
+
+/* Non-zero while thread code is mutating console state; frame ticks skip then. */
+static volatile int console_busy = 0;
+
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
+}
 
 static uint16_t vga_entry(unsigned char ch, uint8_t color) {
     return (uint16_t)ch | ((uint16_t)color << 8);
 }
 
-static void vga_flush(void) {
-    size_t i;
+static size_t ring_index(const struct vga_console *con, size_t screen_row) {
+    return (con->head + screen_row) % VGA_CONSOLE_ROWS;
+}
+
+/* Row currently displayed at `screen_row`, honouring the scrollback view. */
+static uint16_t *display_row(struct vga_console *con, size_t screen_row) {
+    return con->rows[(con->head + VGA_CONSOLE_ROWS - con->view + screen_row) % VGA_CONSOLE_ROWS];
+}
 
-    for (i = 0; i < VGA_SIZE; ++i) {
-        vga_hw[i] = shadow[i];
+static volatile uint16_t *vram_row(size_t row) {
+    if (scroll_mode == VGA_SCROLL_HARDWARE) {
+        row += vram_origin;
     }
+    return &vga_hw[row * VGA_WIDTH];
 }
 
-static void vga_scroll(void) {
+static void vga_clear_row(uint16_t *row) {
     size_t i;
 
-    for (i = 0; i < VGA_WIDTH * (VGA_HEIGHT - 1); ++i) {
-        shadow[i] = shadow[i + VGA_WIDTH];
+    for (i = 0; i < VGA_WIDTH; ++i) {
+        row[i] = vga_entry(' ', VGA_BLANK_ATTR);
+    }
+}
+
+static void console_reset(struct vga_console *con) {
+    size_t row;
+
+    for (row = 0; row < VGA_CONSOLE_ROWS; ++row) {
+        vga_clear_row(con->rows[row]);
+    }
+    con->head = 0;
+    con->history = 0;
+    con->view = 0;
+    con->cursor_row = 0;
+    con->cursor_col = 0;
+}
+
+static void console_scroll(struct vga_console *con) {
+    con->head = (con->head + 1) % VGA_CONSOLE_ROWS;
+    if (con->history < VGA_SCROLLBACK_ROWS) {
+        con->history++;
+    }
+    vga_clear_row(con->rows[ring_index(con, VGA_HEIGHT - 1)]);
+    con->cursor_row = VGA_HEIGHT - 1;
+
+    if (con != active) {
+        return;
+    }
+    if (scroll_mode != VGA_SCROLL_HARDWARE) {
+        dirty_rows = VGA_ALL_ROWS_DIRTY;
+        return;
     }
 
-    for (i = VGA_WIDTH * (VGA_HEIGHT - 1); i < VGA_SIZE; ++i) {
-        shadow[i] = vga_entry(' ', 0x07);
+    if (vram_origin + VGA_HEIGHT >= VGA_VRAM_ROWS) {
+        /*
+         * Out of VRAM below the window: the next commit rewrites the screen at
+         * the top of VRAM (off-screen) and jumps back. Once every ~180 scrolls.
+         */
+        vram_origin = 0;
+        dirty_rows = VGA_ALL_ROWS_DIRTY;
+    } else {
+        /* Committed rows move up with the origin; only the new bottom row is stale. */
+        vram_origin++;
+        dirty_rows = (dirty_rows >> 1) | (1u << (VGA_HEIGHT - 1));
     }
+}
 
-    cursor_row = VGA_HEIGHT - 1;
-    vga_flush();
+static void console_newline(struct vga_console *con) {
+    con->cursor_col = 0;
+    if (++con->cursor_row >= VGA_HEIGHT) {
+        console_scroll(con);
+    }
 }
 
-void vga_clear(void) {
+static void console_write(struct vga_console *con, const unsigned char *bytes, size_t len, uint8_t attr) {
     size_t i;
 
-    for (i = 0; i < VGA_SIZE; ++i) {
-        shadow[i] = vga_entry(' ', 0x07);
+    /* New output on the visible console snaps the view back to the bottom. */
+    if (con == active && con->view != 0) {
+        con->view = 0;
+        dirty_rows = VGA_ALL_ROWS_DIRTY;
     }
 
-    cursor_row = 0;
-    cursor_col = 0;
-    vga_flush();
+    for (i = 0u; i < len; ++i) {
+        if (bytes[i] == '\n') {
+            console_newline(con);
+            continue;
+        }
+        con->rows[ring_index(con, con->cursor_row)][con->cursor_col] = vga_entry(bytes[i], attr);
+        if (con == active) {
+            dirty_rows |= 1u << con->cursor_row;
+        }
+        if (++con->cursor_col >= VGA_WIDTH) {
+            console_newline(con);
+        }
+    }
 }
 
-void vga_putchar(char ch) {
-    size_t pos;
+static void vga_apply_requests(void) {
+    int32_t delta;
+    size_t view;
 
-    if (ch == '\n') {
-        cursor_col = 0;
-        if (++cursor_row >= VGA_HEIGHT) {
-            vga_scroll();
-        }
+    if (pending_console != (int)(active - consoles)) {
+        active = &consoles[pending_console];
+        dirty_rows = VGA_ALL_ROWS_DIRTY;
+    }
+
+    delta = __sync_lock_test_and_set(&pending_view_delta, 0);
+    if (delta == 0) {
         return;
     }
+    view = active->view;
+    if (delta < 0) {
+        view = (size_t)-delta >= view ? 0 : view - (size_t)-delta;
+    } else {
+        view += (size_t)delta;
+        if (view > active->history) {
+            view = active->history;
+        }
+    }
+    if (view != active->view) {
+        active->view = view;
+        dirty_rows = VGA_ALL_ROWS_DIRTY;
+    }
+}
 
-    pos = cursor_row * VGA_WIDTH + cursor_col;
-    shadow[pos] = vga_entry((unsigned char)ch, 0x0F);
-    vga_hw[pos] = shadow[pos];
+/* Copies dirty screen rows to text VRAM, one memcpy per run of contiguous ring rows. */
+static void vga_copy_dirty_text(uint32_t dirty) {
+    size_t row;
+    size_t end;
+    uint16_t *src;
 
-    if (++cursor_col >= VGA_WIDTH) {
-        cursor_col = 0;
-        if (++cursor_row >= VGA_HEIGHT) {
-            vga_scroll();
+    row = 0;
+    while (row < VGA_HEIGHT) {
+        if ((dirty & (1u << row)) == 0u) {
+            ++row;
+            continue;
         }
+        src = display_row(active, row);
+        end = row + 1;
+        while (end < VGA_HEIGHT && (dirty & (1u << end)) != 0u && display_row(active, end) == src + (end - row) * VGA_WIDTH) {
+            ++end;
+        }
+        memcpy((void *)vram_row(row), src, (end - row) * VGA_WIDTH * sizeof(src[0]));
+        row = end;
     }
 }
 
-void vga_puts(const char *str) {
-    while (*str != '\0') {
-        vga_putchar(*str);
-        ++str;
+static void vga_commit_locked(void) {
+    uint32_t dirty;
+    uint32_t flags;
+    uint16_t start;
+    uint16_t cursor;
+    size_t row;
+
+    vga_apply_requests();
+
+    dirty = dirty_rows;
+    dirty_rows = 0u;
+    if (use_framebuffer != 0) {
+        for (row = 0; dirty != 0u; ++row, dirty >>= 1) {
+            if ((dirty & 1u) != 0u) {
+                fb_draw_text_row((uint32_t)row, display_row(active, row), VGA_WIDTH);
+            }
+        }
+        return;
     }
+    vga_copy_dirty_text(dirty);
+
+    start = scroll_mode == VGA_SCROLL_HARDWARE ? (uint16_t)(vram_origin * VGA_WIDTH) : 0u;
+    /* Park the cursor off-screen while looking at scrollback. */
+    if (active->view != 0) {
+        cursor = (uint16_t)(start + VGA_SIZE);
+    } else {
+        cursor = (uint16_t)(start + active->cursor_row * VGA_WIDTH + active->cursor_col);
+    }
+    if (start == hw_start && cursor == hw_cursor) {
+        return;
+    }
+
+    /* Index/data pairs must not interleave with another CRTC writer. */
+    flags = irq_save_disable();
+    if (start != hw_start) {
+        outb(VGA_CRTC_INDEX, VGA_CRTC_START_HIGH);
+        outb(VGA_CRTC_DATA, (uint8_t)(start >> 8));
+        outb(VGA_CRTC_INDEX, VGA_CRTC_START_LOW);
+        outb(VGA_CRTC_DATA, (uint8_t)(start & 0xFFu));
+        hw_start = start;
+    }
+    if (cursor != hw_cursor) {
+        outb(VGA_CRTC_INDEX, VGA_CRTC_CURSOR_HIGH);
+        outb(VGA_CRTC_DATA, (uint8_t)(cursor >> 8));
+        outb(VGA_CRTC_INDEX, VGA_CRTC_CURSOR_LOW);
+        outb(VGA_CRTC_DATA, (uint8_t)(cursor & 0xFFu));
+        hw_cursor = cursor;
+    }
+    irq_restore(flags);
+}
+
+void vga_commit(void) {
+    console_busy++;
+    vga_commit_locked();
+    console_busy--;
+}
+
+void vga_frame_tick(void) {
+    /* Interrupted a writer mid-update: leave the frame to the next tick. */
+    if (console_busy != 0) {
+        return;
+    }
+    vga_commit_locked();
+}
+
+void vga_set_scroll_mode(int mode) {
+    console_busy++;
+    /* The framebuffer has no start-address register; it always redraws from the shadow. */
+    if (use_framebuffer != 0) {
+        mode = VGA_SCROLL_SHADOW;
+    }
+    scroll_mode = mode == VGA_SCROLL_SHADOW ? VGA_SCROLL_SHADOW : VGA_SCROLL_HARDWARE;
+    vram_origin = 0;
+    dirty_rows = VGA_ALL_ROWS_DIRTY;
+    console_busy--;
+}
+
+void vga_attach_framebuffer(void) {
+    if (fb_active() == 0) {
+        return;
+    }
+    console_busy++;
+    use_framebuffer = 1;
+    console_busy--;
+    vga_set_scroll_mode(VGA_SCROLL_SHADOW);
+}
+
+void vga_switch_console(int console) {
+    if (console >= 0 && console < VGA_CONSOLE_COUNT) {
+        pending_console = console;
+    }
+}
+
+int vga_active_console(void) {
+    return (int)(active - consoles);
+}
+
+void vga_scroll_view(int rows) {
+    __sync_fetch_and_add(&pending_view_delta, rows);
+}
+
+static void vga_hotkey_switch(uint16_t key) {
+    vga_switch_console((int)(key - KEY_F1));
+}
+
+static void vga_hotkey_page(uint16_t key) {
+    vga_scroll_view(key == KEY_PAGE_UP ? VGA_HEIGHT / 2 : -(VGA_HEIGHT / 2));
+}
+
+void vga_register_hotkeys(void) {
+    uint16_t i;
+
+    for (i = 0u; i < VGA_CONSOLE_COUNT; ++i) {
+        (void)keyboard_register_hotkey((uint16_t)(KEY_F1 + i), KEYBOARD_MOD_ALT, vga_hotkey_switch);
+    }
+    (void)keyboard_register_hotkey(KEY_PAGE_UP, KEYBOARD_MOD_SHIFT, vga_hotkey_page);
+    (void)keyboard_register_hotkey(KEY_PAGE_DOWN, KEYBOARD_MOD_SHIFT, vga_hotkey_page);
+}
+
+void vga_set_attr(uint8_t attr) {
+    write_attr = attr;
+}
+
+void vga_clear(void) {
+    console_busy++;
+    console_reset(&consoles[VGA_CONSOLE_MAIN]);
+    if (active == &consoles[VGA_CONSOLE_MAIN]) {
+        vram_origin = 0;
+        dirty_rows = VGA_ALL_ROWS_DIRTY;
+    }
+    console_busy--;
+}
+
+void vga_console_write(int console, const void *buf, size_t len, uint8_t attr) {
+    if (console < 0 || console >= VGA_CONSOLE_COUNT) {
+        return;
+    }
+    console_busy++;
+    console_write(&consoles[console], (const unsigned char *)buf, len, attr);
+    console_busy--;
+}
+
+void vga_putchar(char ch) {
+    unsigned char byte = (unsigned char)ch;
+
+    vga_console_write(VGA_CONSOLE_MAIN, &byte, 1u, write_attr);
+}
+
+void vga_write_attr(const void *buf, size_t len, uint8_t attr) {
+    vga_console_write(VGA_CONSOLE_MAIN, buf, len, attr);
+}
+
+void vga_write(const void *buf, size_t len) {
+    vga_console_write(VGA_CONSOLE_MAIN, buf, len, write_attr);
+}
+
+void vga_puts(const char *str) {
+    vga_write(str, strlen(str));
 }
@@ -1,8 +1,65 @@
 #ifndef DRIVERS_VGA_H
 #define DRIVERS_VGA_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * VGA_SCROLL_HARDWARE treats the 32 KiB text window as a ring and scrolls by
+ * moving the CRTC start address; VGA_SCROLL_SHADOW rewrites all 25 rows from
+ * the RAM shadow on each scroll (fallback for adapters without the window).
+ */
+#define VGA_SCROLL_HARDWARE 0
+#define VGA_SCROLL_SHADOW 1
+
+/*
+ * Virtual consoles, each with its own screen, cursor and 103 rows of
+ * scrollback. vga_putchar/vga_puts/vga_write target VGA_CONSOLE_MAIN; klog
+ * mirrors every drained record to VGA_CONSOLE_LOG. Alt+F1..F4 switch the
+ * visible console and Shift+PgUp/PgDn scroll it (see vga_register_hotkeys).
+ */
+#define VGA_CONSOLE_COUNT 4
+#define VGA_CONSOLE_MAIN 0
+#define VGA_CONSOLE_LOG 1
+
+/* Attribute byte: background << 4 | foreground. */
+#define VGA_ATTR_DEFAULT 0x0Fu
+#define VGA_ATTR_WARN 0x0Eu
+#define VGA_ATTR_ERROR 0x0Cu
+
+void vga_set_scroll_mode(int mode);
+
+/*
+ * Renders the console through fb_draw_text_row() from now on (requires a
+ * successful fb_init()); the vga_* API is unchanged for callers.
+ */
+void vga_attach_framebuffer(void);
 void vga_clear(void);
 void vga_putchar(char ch);
 void vga_puts(const char *str);
+void vga_write(const void *buf, size_t len);
+void vga_write_attr(const void *buf, size_t len, uint8_t attr);
+/* Attribute used by vga_putchar/vga_puts/vga_write. */
+void vga_set_attr(uint8_t attr);
+void vga_console_write(int console, const void *buf, size_t len, uint8_t attr);
+
+/*
+ * Console switches and scrollback moves are only recorded here (safe from
+ * IRQ context) and take effect at the next commit, which redraws the screen
+ * with one bulk copy.
+ */
+void vga_switch_console(int console);
+int vga_active_console(void);
+void vga_scroll_view(int rows);
+/* Binds Alt+F1..F4 and Shift+PgUp/PgDn; call after keyboard_init(). */
+void vga_register_hotkeys(void);
+
+/*
+ * Writes only update the RAM shadow. vga_commit() pushes dirty rows plus the
+ * CRTC start address and cursor to the device; vga_frame_tick() does the same
+ * from the timer softirq unless it interrupted a console writer.
+ */
+void vga_commit(void);
+void vga_frame_tick(void);
 
 #endif
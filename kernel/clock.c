@@ -0,0 +1,70 @@
+#include "kernel/clock.h"
+
+#include <stdint.h>
+
+#include "arch/x86/clockevent.h"
+#include "arch/x86/cpu.h"
+#include "arch/x86/tsc.h"
+
+#define NSEC_PER_MSEC 1000000u
+#define NSEC_PER_SEC 1000000000u
+
+static int g_clock_use_tsc;
+static uint64_t g_clock_base;
+/* ns = cycles * g_clock_mult >> g_clock_shift */
+static uint32_t g_clock_mult;
+static uint32_t g_clock_shift;
+
+/* (cycles * mult) >> shift over the full 96-bit product, for shift in 1..32. */
+static uint64_t clock_scale(uint64_t cycles, uint32_t mult, uint32_t shift) {
+    uint64_t lo = (uint64_t)(uint32_t)cycles * mult;
+    uint64_t hi = (uint64_t)(uint32_t)(cycles >> 32) * mult;
+
+    return (hi << (32u - shift)) + (lo >> shift);
+}
+
+void clock_init(void) {
+    uint32_t khz = tsc_khz();
+    uint32_t shift;
+
+    g_clock_use_tsc = 0;
+    if (khz == 0u) {
+        return;
+    }
+
+    /* Largest shift whose multiplier (ns per cycle << shift) still fits in 32 bits. */
+    for (shift = 32u; shift > 1u; --shift) {
+        if ((uint32_t)(((uint64_t)NSEC_PER_MSEC << shift) >> 32) < khz) {
+            break;
+        }
+    }
+    g_clock_shift = shift;
+    g_clock_mult = cpu_div64_32((uint64_t)NSEC_PER_MSEC << shift, khz, (uint32_t *)0);
+    g_clock_base = cpu_rdtsc();
+    g_clock_use_tsc = 1;
+}
+
+const char *clock_source_name(void) {
+    if (g_clock_use_tsc == 0) {
+        return "ticks";
+    }
+    return cpu_has_feature(CPU_FEATURE_INVARIANT_TSC) != 0 ? "tsc-invariant" : "tsc";
+}
+
+uint64_t clock_monotonic_ns(void) {
+    uint32_t hz;
+
+    if (g_clock_use_tsc != 0) {
+        return clock_scale(cpu_rdtsc() - g_clock_base, g_clock_mult, g_clock_shift);
+    }
+    hz = clockevent_frequency();
+    return hz != 0u ? (uint64_t)clockevent_ticks() * (NSEC_PER_SEC / hz) : 0u;
+}
+
+uint64_t clock_cycles(void) {
+    return g_clock_use_tsc != 0 ? cpu_rdtsc() : 0u;
+}
+
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    return g_clock_use_tsc != 0 ? clock_scale(cycles, g_clock_mult, g_clock_shift) : 0u;
+}
@@ -0,0 +1,23 @@
+#ifndef KERNEL_CLOCK_H
+#define KERNEL_CLOCK_H
+
+#include <stdint.h>
+
+/*
+ * Monotonic clock. With a TSC calibrated by tsc_init() it reads rdtsc and
+ * scales cycles to nanoseconds with a precomputed mult/shift pair (no
+ * division per read). Otherwise it falls back to timer ticks, which
+ * resolve only 1/hz s. Call after tsc_init() and clockevent_init().
+ */
+void clock_init(void);
+/* "tsc-invariant", "tsc" (rate may vary with power states) or "ticks". */
+const char *clock_source_name(void);
+
+/* Nanoseconds since clock_init(). */
+uint64_t clock_monotonic_ns(void);
+
+/* Raw cycle counter for timing hot paths; always 0 without a TSC. */
+uint64_t clock_cycles(void);
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+#endif
@@ -1,11 +1,16 @@
 #include "kernel/fmt.h"
 
-void put_hex32(uint32_t value, void (*puts)(const char *), void (*putchar)(char)) {
+void put_hex32(uint32_t value, void (*puts)(const char *)) {
     static const char hex[] = "0123456789ABCDEF";
+    char buf[11];
     int shift;
+    int pos = 2;
 
-    puts("0x");
+    buf[0] = '0';
+    buf[1] = 'x';
     for (shift = 28; shift >= 0; shift -= 4) {
-        putchar(hex[(value >> shift) & 0x0Fu]);
+        buf[pos++] = hex[(value >> shift) & 0x0Fu];
     }
+    buf[pos] = '\0';
+    puts(buf);
 }
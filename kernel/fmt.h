@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 
-void put_hex32(uint32_t value, void (*puts)(const char *), void (*putchar)(char));
+/* Formats "0x" plus eight hex digits and hands the whole string to `puts` once. */
+void put_hex32(uint32_t value, void (*puts)(const char *));
 
 #endif
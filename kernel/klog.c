@@ -0,0 +1,204 @@
+#include "kernel/klog.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "arch/x86/pit.h"
+#include "drivers/serial.h"
+#include "drivers/vga.h"
+#include "kernel/fmt.h"
+#include "kernel/kprintf.h"
+#include "kernel/string.h"
+
+/* Power of two: indices run freely and are masked on access. */
+#define KLOG_RING_SIZE 256u
+#define KLOG_RING_MASK (KLOG_RING_SIZE - 1u)
+#define KLOG_TEXT_MAX 54u
+
+/*
+ * `ready` holds the reservation sequence + 1 once the record is fully written,
+ * so a slot reused after wrap-around is never mistaken for a committed one.
+ */
+struct klog_record {
+    volatile uint32_t ready;
+    uint32_t tick;
+    uint8_t level;
+    uint8_t len;
+    char text[KLOG_TEXT_MAX];
+};
+
+static struct klog_record g_ring[KLOG_RING_SIZE];
+static volatile uint32_t g_head;
+static volatile uint32_t g_tail;
+static volatile uint32_t g_dropped;
+static volatile uint32_t g_dropped_reported;
+static volatile int g_min_level = KLOG_DEBUG;
+
+static uint32_t klog_copy(char *dst, uint32_t pos, const char *src) {
+    if (src == (const char *)0) {
+        return pos;
+    }
+    while (*src != '\0' && pos < KLOG_TEXT_MAX) {
+        dst[pos++] = *src++;
+    }
+    return pos;
+}
+
+static uint32_t klog_copy_hex(char *dst, uint32_t pos, uint32_t value) {
+    static const char hex[] = "0123456789ABCDEF";
+    int shift;
+
+    pos = klog_copy(dst, pos, "0x");
+    for (shift = 28; shift >= 0 && pos < KLOG_TEXT_MAX; shift -= 4) {
+        dst[pos++] = hex[(value >> shift) & 0x0Fu];
+    }
+    return pos;
+}
+
+static void klog_append(int level, const char *prefix, int has_value, uint32_t value, const char *suffix) {
+    struct klog_record *rec;
+    uint32_t head;
+    uint32_t pos;
+
+    if (level < g_min_level) {
+        return;
+    }
+
+    /* Reserve a slot; a nested IRQ producer simply takes the next one. */
+    do {
+        head = g_head;
+        if (head - g_tail >= KLOG_RING_SIZE) {
+            __sync_fetch_and_add(&g_dropped, 1u);
+            return;
+        }
+    } while (!__sync_bool_compare_and_swap(&g_head, head, head + 1u));
+
+    rec = &g_ring[head & KLOG_RING_MASK];
+    rec->tick = pit_get_ticks();
+    rec->level = (uint8_t)level;
+    pos = klog_copy(rec->text, 0u, prefix);
+    if (has_value != 0) {
+        pos = klog_copy_hex(rec->text, pos, value);
+    }
+    pos = klog_copy(rec->text, pos, suffix);
+    rec->len = (uint8_t)pos;
+
+    __sync_synchronize();
+    rec->ready = head + 1u;
+}
+
+void klog_write(int level, const char *msg) {
+    klog_append(level, msg, 0, 0u, (const char *)0);
+}
+
+void klog_write_hex(int level, const char *prefix, uint32_t value, const char *suffix) {
+    klog_append(level, prefix, 1, value, suffix);
+}
+
+void klogf(int level, const char *fmt, ...) {
+    char text[KLOG_TEXT_MAX + 1u];
+    va_list ap;
+
+    /* Filter before formatting so suppressed levels cost nothing. */
+    if (level < g_min_level) {
+        return;
+    }
+    va_start(ap, fmt);
+    (void)kvsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    klog_append(level, text, 0, 0u, (const char *)0);
+}
+
+void klog_set_level(int level) {
+    g_min_level = level;
+}
+
+int klog_get_level(void) {
+    return g_min_level;
+}
+
+int klog_pending(void) {
+    uint32_t tail = g_tail;
+
+    return g_ring[tail & KLOG_RING_MASK].ready == tail + 1u || g_dropped != g_dropped_reported;
+}
+
+uint32_t klog_dropped(void) {
+    return g_dropped;
+}
+
+static const char *klog_level_tag(uint8_t level) {
+    switch (level) {
+    case KLOG_DEBUG:
+        return "D ";
+    case KLOG_INFO:
+        return "I ";
+    case KLOG_WARN:
+        return "W ";
+    default:
+        return "E ";
+    }
+}
+
+static void klog_emit(uint32_t tick, uint8_t level, const char *text) {
+    uint8_t attr;
+
+    serial_puts("[");
+    put_hex32(tick, serial_puts);
+    serial_puts("] ");
+    serial_puts(klog_level_tag(level));
+    serial_puts(text);
+    serial_puts("\n");
+
+    /* The log console keeps every record; it is only drawn while it is shown. */
+    attr = level >= KLOG_ERROR ? VGA_ATTR_ERROR : level >= KLOG_WARN ? VGA_ATTR_WARN : VGA_ATTR_DEFAULT;
+    vga_console_write(VGA_CONSOLE_LOG, klog_level_tag(level), 2u, attr);
+    vga_console_write(VGA_CONSOLE_LOG, text, strlen(text), attr);
+    vga_console_write(VGA_CONSOLE_LOG, "\n", 1u, attr);
+
+    if (level >= KLOG_WARN) {
+        vga_write_attr(text, strlen(text), attr);
+        vga_putchar('\n');
+    }
+}
+
+/* Single consumer: call from thread context only (idle loop or a task). */
+void klog_drain(void) {
+    struct klog_record *rec;
+    char text[KLOG_TEXT_MAX + 1u];
+    uint32_t tail;
+    uint32_t tick;
+    uint32_t dropped;
+    uint8_t level;
+    uint32_t i;
+
+    for (;;) {
+        tail = g_tail;
+        rec = &g_ring[tail & KLOG_RING_MASK];
+        if (rec->ready != tail + 1u) {
+            break;
+        }
+        __sync_synchronize();
+
+        tick = rec->tick;
+        level = rec->level;
+        for (i = 0u; i < rec->len; ++i) {
+            text[i] = rec->text[i];
+        }
+        text[i] = '\0';
+
+        /* Release the slot before the slow UART/VGA output. */
+        __sync_synchronize();
+        g_tail = tail + 1u;
+
+        klog_emit(tick, level, text);
+    }
+
+    dropped = g_dropped;
+    if (dropped != g_dropped_reported) {
+        serial_puts("[klog] dropped records total=");
+        put_hex32(dropped, serial_puts);
+        serial_puts("\n");
+        g_dropped_reported = dropped;
+    }
+}
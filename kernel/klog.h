@@ -0,0 +1,30 @@
+#ifndef KERNEL_KLOG_H
+#define KERNEL_KLOG_H
+
+#include <stdint.h>
+
+#define KLOG_DEBUG 0
+#define KLOG_INFO 1
+#define KLOG_WARN 2
+#define KLOG_ERROR 3
+
+/*
+ * Deferred kernel log. Producers (including IRQ handlers) only copy a record
+ * into a lock-free ring; klog_drain() prints queued records from thread
+ * context. Records at or above KLOG_WARN are mirrored to VGA when drained.
+ * When the ring is full new records are dropped and counted.
+ */
+void klog_write(int level, const char *msg);
+void klog_write_hex(int level, const char *prefix, uint32_t value, const char *suffix);
+/* kprintf-style record; formatted on the producer's stack, truncated to the record size. */
+void klogf(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/* Records below `level` are discarded at append time. */
+void klog_set_level(int level);
+int klog_get_level(void);
+
+int klog_pending(void);
+void klog_drain(void);
+uint32_t klog_dropped(void);
+
+#endif
@@ -0,0 +1,288 @@
+#include "kernel/kprintf.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arch/x86/irqflags.h"
+#include "kernel/numfmt.h"
+
+struct kfmt_out {
+    char *buf;
+    size_t size;
+    size_t len;
+};
+
+/* Arguments come from a va_list (C callers) or an int array (FFI). */
+struct kfmt_args {
+    va_list *ap;
+    const int32_t *array;
+    size_t count;
+    size_t next;
+};
+
+static kprintf_sink_fn g_sinks[KPRINTF_MAX_SINKS];
+static uint32_t g_sink_count;
+
+static void kfmt_put(struct kfmt_out *out, char ch) {
+    if (out->len + 1u < out->size) {
+        out->buf[out->len] = ch;
+    }
+    out->len++;
+}
+
+static void kfmt_pad(struct kfmt_out *out, char ch, int count) {
+    while (count-- > 0) {
+        kfmt_put(out, ch);
+    }
+}
+
+static void kfmt_span(struct kfmt_out *out, const char *str, size_t len) {
+    size_t i;
+
+    for (i = 0u; i < len; ++i) {
+        kfmt_put(out, str[i]);
+    }
+}
+
+static uint32_t kfmt_next_u32(struct kfmt_args *args) {
+    if (args->ap != (va_list *)0) {
+        return va_arg(*args->ap, uint32_t);
+    }
+    if (args->next >= args->count) {
+        return 0u;
+    }
+    return (uint32_t)args->array[args->next++];
+}
+
+static const char *kfmt_next_str(struct kfmt_args *args) {
+    if (args->ap != (va_list *)0) {
+        return va_arg(*args->ap, const char *);
+    }
+    (void)kfmt_next_u32(args);
+    return "(?)";
+}
+
+/* Emits `digits` (len bytes) with an optional sign/prefix, honouring width and flags. */
+static void kfmt_field(struct kfmt_out *out, const char *prefix, const char *digits, size_t len, int width, int left,
+                       int zero) {
+    size_t prefix_len = 0u;
+    int pad;
+
+    while (prefix[prefix_len] != '\0') {
+        prefix_len++;
+    }
+    pad = width - (int)(prefix_len + len);
+
+    if (left == 0 && zero == 0) {
+        kfmt_pad(out, ' ', pad);
+    }
+    kfmt_span(out, prefix, prefix_len);
+    if (left == 0 && zero != 0) {
+        kfmt_pad(out, '0', pad);
+    }
+    kfmt_span(out, digits, len);
+    if (left != 0) {
+        kfmt_pad(out, ' ', pad);
+    }
+}
+
+/* Writes `value` in `base` (10 or 16) to tmp; returns tmp with the length in *len. */
+static const char *kfmt_digits(uint32_t value, uint32_t base, int upper, char tmp[12], size_t *len) {
+    *len = base == 10u ? numfmt_u32_dec(tmp, value) : numfmt_u32_hex(tmp, value, upper);
+    return tmp;
+}
+
+static int kfmt_core(struct kfmt_out *out, const char *fmt, const char *end, struct kfmt_args *args) {
+    char tmp[12];
+    const char *digits;
+    const char *str;
+    size_t len;
+    uint32_t value;
+    int32_t signed_value;
+    int width;
+    int left;
+    int zero;
+    char ch;
+
+    while (fmt < end) {
+        /* Copy literal runs up to the next conversion. */
+        if (*fmt != '%') {
+            kfmt_put(out, *fmt++);
+            continue;
+        }
+        if (++fmt >= end) {
+            break;
+        }
+
+        left = 0;
+        zero = 0;
+        for (; fmt < end && (*fmt == '-' || *fmt == '0'); ++fmt) {
+            if (*fmt == '-') {
+                left = 1;
+            } else {
+                zero = 1;
+            }
+        }
+        width = 0;
+        if (fmt < end && *fmt == '*') {
+            width = (int)kfmt_next_u32(args);
+            if (width < 0) {
+                left = 1;
+                width = -width;
+            }
+            ++fmt;
+        }
+        for (; fmt < end && *fmt >= '0' && *fmt <= '9'; ++fmt) {
+            width = width * 10 + (*fmt - '0');
+        }
+        for (; fmt < end && (*fmt == 'l' || *fmt == 'h'); ++fmt) {
+        }
+        if (fmt >= end) {
+            break;
+        }
+
+        ch = *fmt++;
+        switch (ch) {
+        case 'd':
+        case 'i':
+            signed_value = (int32_t)kfmt_next_u32(args);
+            value = signed_value < 0 ? 0u - (uint32_t)signed_value : (uint32_t)signed_value;
+            digits = kfmt_digits(value, 10u, 0, tmp, &len);
+            kfmt_field(out, signed_value < 0 ? "-" : "", digits, len, width, left, zero);
+            break;
+        case 'u':
+            digits = kfmt_digits(kfmt_next_u32(args), 10u, 0, tmp, &len);
+            kfmt_field(out, "", digits, len, width, left, zero);
+            break;
+        case 'x':
+        case 'X':
+            digits = kfmt_digits(kfmt_next_u32(args), 16u, ch == 'X', tmp, &len);
+            kfmt_field(out, "", digits, len, width, left, zero);
+            break;
+        case 'p':
+            /* Pointers are always shown as 0x plus eight upper-case digits. */
+            digits = kfmt_digits(kfmt_next_u32(args), 16u, 1, tmp, &len);
+            kfmt_field(out, "0x", digits, len, 10, 0, 1);
+            break;
+        case 's':
+            str = kfmt_next_str(args);
+            if (str == (const char *)0) {
+                str = "(null)";
+            }
+            for (len = 0u; str[len] != '\0'; ++len) {
+            }
+            kfmt_field(out, "", str, len, width, left, 0);
+            break;
+        case 'c':
+            tmp[0] = (char)kfmt_next_u32(args);
+            kfmt_field(out, "", tmp, 1u, width, left, 0);
+            break;
+        case '%':
+            kfmt_put(out, '%');
+            break;
+        default:
+            /* Unknown conversion: print it verbatim so the mistake is visible. */
+            kfmt_put(out, '%');
+            kfmt_put(out, ch);
+            break;
+        }
+    }
+
+    if (out->size != 0u) {
+        out->buf[out->len < out->size ? out->len : out->size - 1u] = '\0';
+    }
+    return (int)out->len;
+}
+
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list ap) {
+    struct kfmt_out out;
+    struct kfmt_args args;
+    const char *end;
+    va_list copy;
+    int len;
+
+    out.buf = buf;
+    out.size = size;
+    out.len = 0u;
+    va_copy(copy, ap);
+    args.ap = &copy;
+    args.array = (const int32_t *)0;
+    args.count = 0u;
+    args.next = 0u;
+    for (end = fmt; *end != '\0'; ++end) {
+    }
+    len = kfmt_core(&out, fmt, end, &args);
+    va_end(copy);
+    return len;
+}
+
+int ksnprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = kvsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return len;
+}
+
+int kformat_args(char *buf, size_t size, const char *fmt, size_t fmt_len, const int32_t *args, size_t nargs) {
+    struct kfmt_out out;
+    struct kfmt_args source;
+
+    out.buf = buf;
+    out.size = size;
+    out.len = 0u;
+    source.ap = (va_list *)0;
+    source.array = args;
+    source.count = args != (const int32_t *)0 ? nargs : 0u;
+    source.next = 0u;
+    return kfmt_core(&out, fmt, fmt + fmt_len, &source);
+}
+
+int kprintf_add_sink(kprintf_sink_fn sink) {
+    uint32_t flags;
+    uint32_t i;
+
+    if (sink == (kprintf_sink_fn)0) {
+        return 0;
+    }
+    flags = irq_save_disable();
+    for (i = 0u; i < g_sink_count; ++i) {
+        if (g_sinks[i] == sink) {
+            irq_restore(flags);
+            return 1;
+        }
+    }
+    if (g_sink_count >= KPRINTF_MAX_SINKS) {
+        irq_restore(flags);
+        return 0;
+    }
+    g_sinks[g_sink_count++] = sink;
+    irq_restore(flags);
+    return 1;
+}
+
+void kprintf_emit(const char *buf, size_t len) {
+    uint32_t i;
+
+    if (len == 0u) {
+        return;
+    }
+    for (i = 0u; i < g_sink_count; ++i) {
+        g_sinks[i](buf, len);
+    }
+}
+
+int kprintf(const char *fmt, ...) {
+    char buf[KPRINTF_BUF_SIZE];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = kvsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    kprintf_emit(buf, (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1u);
+    return len;
+}
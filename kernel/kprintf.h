@@ -0,0 +1,34 @@
+#ifndef KERNEL_KPRINTF_H
+#define KERNEL_KPRINTF_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define KPRINTF_MAX_SINKS 4u
+/* Longer messages are truncated; kprintf formats on the stack. */
+#define KPRINTF_BUF_SIZE 256u
+
+/*
+ * Conversions: %d %i %u %x %X %p %s %c %%, with '-' and '0' flags, a width
+ * (digits or '*') and an ignored 'l'/'h' length modifier. The snprintf-style
+ * functions always NUL-terminate (size > 0) and return the untruncated length.
+ */
+typedef void (*kprintf_sink_fn)(const void *buf, size_t len);
+
+/* kprintf() hands each formatted message to every registered sink in one call. */
+int kprintf_add_sink(kprintf_sink_fn sink);
+
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list ap);
+int ksnprintf(char *buf, size_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+int kprintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/*
+ * Same conversions with `fmt` given as a byte span and arguments taken from
+ * an int array (for the MoonBit FFI). %s has no string source here and prints
+ * "(?)"; missing arguments read as 0.
+ */
+int kformat_args(char *buf, size_t size, const char *fmt, size_t fmt_len, const int32_t *args, size_t nargs);
+void kprintf_emit(const char *buf, size_t len);
+
+#endif
@@ -1,13 +1,26 @@
 #include <stdint.h>
+#include "arch/x86/clockevent.h"
+#include "arch/x86/cpu.h"
 #include "arch/x86/idt.h"
+#include "arch/x86/irq_controller.h"
+#include "arch/x86/irq_stats.h"
+#include "arch/x86/isr_dispatch.h"
 #include "arch/x86/keyboard.h"
 #include "arch/x86/pic.h"
-#include "arch/x86/pit.h"
+#include "arch/x86/tsc.h"
+#include "drivers/fb.h"
 #include "drivers/vga.h"
 #include "drivers/serial.h"
+#include "kernel/clock.h"
 #include "kernel/fmt.h"
-
-#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002u
+#include "kernel/kprintf.h"
+#include "kernel/klog.h"
+#include "kernel/multiboot.h"
+#include "kernel/profile.h"
+#include "kernel/softirq.h"
+#include "kernel/string.h"
+#include "kernel/timer.h"
+#include "kernel/trace.h"
 
 static void enable_interrupts(void) {
     __asm__ volatile("sti");
@@ -15,7 +28,19 @@ static void enable_interrupts(void) {
 
 static void cpu_idle_forever(void) {
     for (;;) {
-        __asm__ volatile("hlt");
+        softirq_run();
+        timer_run();
+        klog_drain();
+        trace_poll();
+        /* sti takes effect after hlt issues, so work queued in between still wakes us. */
+        __asm__ volatile("cli");
+        if (softirq_pending() != 0 || klog_pending() != 0 || timer_pending() != 0) {
+            __asm__ volatile("sti");
+        } else {
+            clockevent_idle_enter();
+            __asm__ volatile("sti; hlt");
+            clockevent_idle_exit();
+        }
     }
 }
 
@@ -26,56 +51,213 @@ static void maybe_trigger_fault_selftest(void) {
 #endif
 }
 
+#if defined(IRQ_NEST_SELFTEST)
+#define CMOS_INDEX 0x70u
+#define CMOS_DATA 0x71u
+#define CMOS_NMI_DISABLE 0x80u
+#define RTC_REG_A 0x0Au
+#define RTC_REG_B 0x0Bu
+#define RTC_REG_C 0x0Cu
+#define RTC_B_PERIODIC 0x40u
+/* 32768 Hz >> (13 - 1) = 8 Hz. */
+#define RTC_RATE_8HZ 13u
+#define RTC_IRQ_LINE 8u
+#define NEST_SELFTEST_SPIN_NS 20000000u
+#define NEST_SELFTEST_REPORT_TICKS 200u
+
+static struct timer g_nest_selftest_busy;
+static struct timer g_nest_selftest_report;
+
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static uint8_t cmos_read(uint8_t reg) {
+    outb(CMOS_INDEX, (uint8_t)(CMOS_NMI_DISABLE | reg));
+    return inb(CMOS_DATA);
+}
+
+static void cmos_write(uint8_t reg, uint8_t value) {
+    outb(CMOS_INDEX, (uint8_t)(CMOS_NMI_DISABLE | reg));
+    outb(CMOS_DATA, value);
+}
+
+/* A deliberately slow device: acknowledge the RTC, then hold the CPU for two tick periods. */
+static void nest_selftest_rtc_irq(uint8_t irq_line, const struct isr_frame *frame) {
+    uint64_t start;
+
+    (void)irq_line;
+    (void)frame;
+    (void)cmos_read(RTC_REG_C);
+    start = clock_monotonic_ns();
+    while (clock_monotonic_ns() - start < NEST_SELFTEST_SPIN_NS) {
+    }
+}
+
+/* Keeps every 10 ms boundary an armed one-shot event, so each one's lateness is measured. */
+static void nest_selftest_busy(struct timer *timer, void *arg) {
+    (void)timer;
+    (void)arg;
+}
+
+static void nest_selftest_report(struct timer *timer, void *arg) {
+    (void)timer;
+    (void)arg;
+    klogf(KLOG_INFO, "[selftest] nested irqs %s: max tick lateness %u us", isr_irq_nesting() != 0 ? "on" : "off",
+          clockevent_take_max_lateness_ns() / 1000u);
+}
+#endif
+
+static void maybe_start_nest_selftest(void) {
+#if defined(IRQ_NEST_SELFTEST)
+    /* The spin and the lateness figure both need the TSC. */
+    if (tsc_khz() == 0u) {
+        serial_puts("[selftest] nested irqs: no TSC, skipped\n");
+        return;
+    }
+    serial_puts("[selftest] nested irqs: 8 Hz RTC IRQ8 spinning 20 ms per interrupt\n");
+    isr_register_irq_handler(RTC_IRQ_LINE, nest_selftest_rtc_irq);
+    cmos_write(RTC_REG_A, (uint8_t)((cmos_read(RTC_REG_A) & 0xF0u) | RTC_RATE_8HZ));
+    cmos_write(RTC_REG_B, (uint8_t)(cmos_read(RTC_REG_B) | RTC_B_PERIODIC));
+    (void)cmos_read(RTC_REG_C);
+    irq_unmask(2u);
+    irq_unmask(RTC_IRQ_LINE);
+
+    timer_setup(&g_nest_selftest_busy, nest_selftest_busy, (void *)0);
+    timer_arm(&g_nest_selftest_busy, 1u, 1u);
+    timer_setup(&g_nest_selftest_report, nest_selftest_report, (void *)0);
+    timer_arm(&g_nest_selftest_report, NEST_SELFTEST_REPORT_TICKS, NEST_SELFTEST_REPORT_TICKS);
+#endif
+}
+
 static void irq_baseline_masking(void) {
     uint8_t irq;
 
     for (irq = 0u; irq < 16u; ++irq) {
-        pic_set_mask(irq);
+        irq_mask(irq);
     }
-    pic_clear_mask(0u);
-    pic_clear_mask(1u);
+    irq_unmask(0u);
+    irq_unmask(1u);
+    irq_unmask(4u);
+}
+
+static void interrupt_controller_setup(void) {
+    /* "noapic" keeps the 8259 for comparison (see the [isr] heartbeat cost lines). */
+    if (irq_controller_init(multiboot_cmdline_has_option("noapic") == 0) != 0) {
+        serial_puts("Interrupts routed through LAPIC/IO-APIC.\n");
+    } else {
+        serial_puts("Interrupts routed through 8259 PIC.\n");
+    }
+    /* "nestirq" lets higher-priority IRQs (above all the tick) preempt a running handler. */
+    if (multiboot_cmdline_has_option("nestirq") != 0) {
+        isr_set_irq_nesting(1);
+        serial_puts("Nested IRQs enabled.\n");
+    }
+}
+
+static void clock_setup(void) {
+    char line[80];
+
+    if (tsc_init() != 0) {
+        ksnprintf(line, sizeof(line), "TSC calibrated at %u kHz.\n", tsc_khz());
+        serial_puts(line);
+    }
+    /* "periodic" keeps the fixed-rate PIT tick for comparison. */
+    clockevent_init(100u, multiboot_cmdline_has_option("periodic") == 0);
+    ksnprintf(line, sizeof(line), "Timer tick: %s at 100Hz.\n", clockevent_name());
+    serial_puts(line);
+    clock_init();
+    ksnprintf(line, sizeof(line), "Monotonic clock source: %s.\n", clock_source_name());
+    serial_puts(line);
+}
+
+static void profiler_setup(void) {
+    char line[80];
+
+    /* "profile" samples from boot; tools/profile_symbolize.py reads the dump. */
+    if (multiboot_cmdline_has_option("profile") == 0) {
+        return;
+    }
+    profile_start(PROFILE_DEFAULT_HZ);
+    ksnprintf(line, sizeof(line), "Sampling profiler running at %u Hz; F11 stops and dumps.\n", PROFILE_DEFAULT_HZ);
+    serial_puts(line);
+}
+
+static void console_setup(void) {
+    if (multiboot_cmdline_has_option("fbcon") == 0) {
+        return;
+    }
+    if (fb_init() == 0) {
+        serial_puts("fbcon: no linear framebuffer, staying in text mode.\n");
+        return;
+    }
+    vga_attach_framebuffer();
+    serial_puts("fbcon: console on linear framebuffer.\n");
 }
 
 void kernel_main(uint32_t multiboot_magic, uint32_t multiboot_info_addr) {
+    uintptr_t free_base;
+    uintptr_t free_length;
+
+    cpu_init();
+    string_init();
     serial_init();
     serial_puts("COM1 serial initialized.\n");
+    serial_puts("String ops variant: ");
+    serial_puts(string_variant());
+    serial_puts("\n");
     idt_init();
     serial_puts("IDT loaded (256 entries).\n");
     pic_remap(0x20u, 0x28u);
     serial_puts("PIC remapped to vectors 0x20-0x2F.\n");
     irq_baseline_masking();
-    pit_init(100u);
+    trace_init();
     keyboard_init();
-    serial_puts("PIT IRQ0 enabled at 100Hz.\n");
+    vga_register_hotkeys();
+    irq_stats_init();
+    profile_init();
+    serial_enable_tx_irq();
     serial_puts("Keyboard IRQ1 enabled.\n");
+    serial_puts("COM1 IRQ4 transmit ring enabled.\n");
 
     vga_clear();
-    vga_puts("Hello from bare metal C kernel!\n");
-    vga_puts("Multiboot magic: ");
-    put_hex32(multiboot_magic, vga_puts, vga_putchar);
-    vga_puts("\n");
-    vga_puts("Multiboot info:  ");
-    put_hex32(multiboot_info_addr, vga_puts, vga_putchar);
-    vga_puts("\n");
-
-    serial_puts("Hello from bare metal C kernel!\n");
-    serial_puts("Multiboot magic: ");
-    put_hex32(multiboot_magic, serial_puts, serial_putchar);
-    serial_puts("\n");
-    serial_puts("Multiboot info:  ");
-    put_hex32(multiboot_info_addr, serial_puts, serial_putchar);
-    serial_puts("\n");
+    kprintf_add_sink(serial_write);
+    kprintf_add_sink(vga_write);
+    kprintf("Hello from bare metal C kernel!\n"
+            "Multiboot magic: 0x%08X\n"
+            "Multiboot info:  0x%08X\n",
+            multiboot_magic, multiboot_info_addr);
 
     if (multiboot_magic != MULTIBOOT_BOOTLOADER_MAGIC) {
-        vga_puts("ERROR: Invalid multiboot magic.\n");
-        serial_puts("ERROR: Invalid multiboot magic.\n");
+        kprintf("ERROR: Invalid multiboot magic.\n");
+        vga_commit();
+        serial_flush_sync();
         return;
     }
 
-    vga_puts("Kernel C path is running.\n");
-    serial_puts("Kernel C path is running.\n");
+    multiboot_init(multiboot_magic, multiboot_info_addr);
+    console_setup();
+    interrupt_controller_setup();
+    clock_setup();
+    profiler_setup();
+    if (multiboot_largest_free_region(&free_base, &free_length) != 0) {
+        serial_puts("Largest free memory region: base=");
+        put_hex32((uint32_t)free_base, serial_puts);
+        serial_puts(" size=");
+        put_hex32((uint32_t)free_length, serial_puts);
+        serial_puts("\n");
+    }
+
+    kprintf("Kernel C path is running.\n");
 
     maybe_trigger_fault_selftest();
+    maybe_start_nest_selftest();
     enable_interrupts();
     cpu_idle_forever();
 }
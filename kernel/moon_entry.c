@@ -1,11 +1,28 @@
 #include <stdint.h>
 
+#include "arch/x86/clockevent.h"
+#include "arch/x86/cpu.h"
 #include "arch/x86/idt.h"
+#include "arch/x86/irq_controller.h"
+#include "arch/x86/irq_stats.h"
+#include "arch/x86/isr_dispatch.h"
 #include "arch/x86/keyboard.h"
 #include "arch/x86/pic.h"
-#include "arch/x86/pit.h"
+#include "arch/x86/tsc.h"
+#include "drivers/fb.h"
 #include "drivers/serial.h"
 #include "drivers/vga.h"
+#include "kernel/clock.h"
+#include "kernel/fmt.h"
+#include "kernel/kprintf.h"
+#include "kernel/klog.h"
+#include "kernel/multiboot.h"
+#include "kernel/profile.h"
+#include "kernel/softirq.h"
+#include "kernel/string.h"
+#include "kernel/timer.h"
+#include "kernel/trace.h"
+#include "runtime/heap.h"
 
 int main(int argc, char **argv);
 
@@ -15,7 +32,19 @@ static void enable_interrupts(void) {
 
 static void cpu_idle_forever(void) {
     for (;;) {
-        __asm__ volatile("hlt");
+        softirq_run();
+        timer_run();
+        klog_drain();
+        trace_poll();
+        /* sti takes effect after hlt issues, so work queued in between still wakes us. */
+        __asm__ volatile("cli");
+        if (softirq_pending() != 0 || klog_pending() != 0 || timer_pending() != 0) {
+            __asm__ volatile("sti");
+        } else {
+            clockevent_idle_enter();
+            __asm__ volatile("sti; hlt");
+            clockevent_idle_exit();
+        }
     }
 }
 
@@ -23,28 +52,114 @@ static void irq_baseline_masking(void) {
     uint8_t irq;
 
     for (irq = 0u; irq < 16u; ++irq) {
-        pic_set_mask(irq);
+        irq_mask(irq);
     }
-    pic_clear_mask(0u);
-    pic_clear_mask(1u);
+    irq_unmask(0u);
+    irq_unmask(1u);
+    irq_unmask(4u);
 }
 
-void kernel_main(uint32_t multiboot_magic, uint32_t multiboot_info_addr) {
-    (void)multiboot_magic;
-    (void)multiboot_info_addr;
+static void heap_setup(void) {
+    uintptr_t base;
+    uintptr_t length;
+
+    if (multiboot_largest_free_region(&base, &length) == 0 || heap_set_region((void *)base, length) == 0) {
+        serial_puts("[moon-kernel] heap: no usable memory map, using bootstrap arena\n");
+    } else {
+        serial_puts("[moon-kernel] heap: base=");
+        put_hex32((uint32_t)base, serial_puts);
+        serial_puts(" size=");
+        put_hex32((uint32_t)length, serial_puts);
+        serial_puts("\n");
+    }
+    /* "heapprof" records allocation call sites from boot; every allocation pays for it, so it is off by default. */
+    if (multiboot_cmdline_has_option("heapprof") != 0) {
+        heap_set_callsite_profiling(1);
+        serial_puts("[moon-kernel] heap: call-site profiling enabled\n");
+    }
+}
+
+static void interrupt_controller_setup(void) {
+    if (irq_controller_init(multiboot_cmdline_has_option("noapic") == 0) != 0) {
+        serial_puts("[moon-kernel] interrupts via LAPIC/IO-APIC\n");
+    } else {
+        serial_puts("[moon-kernel] interrupts via 8259 PIC\n");
+    }
+    if (multiboot_cmdline_has_option("nestirq") != 0) {
+        isr_set_irq_nesting(1);
+        serial_puts("[moon-kernel] nested IRQs enabled\n");
+    }
+}
+
+static void clock_setup(void) {
+    char line[80];
+
+    if (tsc_init() != 0) {
+        ksnprintf(line, sizeof(line), "[moon-kernel] TSC %u kHz\n", tsc_khz());
+        serial_puts(line);
+    }
+    clockevent_init(100u, multiboot_cmdline_has_option("periodic") == 0);
+    ksnprintf(line, sizeof(line), "[moon-kernel] timer tick: %s (100Hz)\n", clockevent_name());
+    serial_puts(line);
+    clock_init();
+    ksnprintf(line, sizeof(line), "[moon-kernel] clock source: %s\n", clock_source_name());
+    serial_puts(line);
+}
+
+static void profiler_setup(void) {
+    char line[80];
+
+    /* "profile" samples from boot; tools/profile_symbolize.py reads the dump. */
+    if (multiboot_cmdline_has_option("profile") == 0) {
+        return;
+    }
+    profile_start(PROFILE_DEFAULT_HZ);
+    ksnprintf(line, sizeof(line), "[moon-kernel] profiler: %u Hz, F11 stops and dumps\n", PROFILE_DEFAULT_HZ);
+    serial_puts(line);
+}
 
+static void console_setup(void) {
+    if (multiboot_cmdline_has_option("fbcon") == 0) {
+        return;
+    }
+    if (fb_init() == 0) {
+        serial_puts("[moon-kernel] fbcon: no linear framebuffer, staying in text mode\n");
+        return;
+    }
+    vga_attach_framebuffer();
+    serial_puts("[moon-kernel] fbcon: console on linear framebuffer\n");
+}
+
+void kernel_main(uint32_t multiboot_magic, uint32_t multiboot_info_addr) {
+    cpu_init();
+    string_init();
     serial_init();
+    multiboot_init(multiboot_magic, multiboot_info_addr);
+    heap_setup();
     idt_init();
     pic_remap(0x20u, 0x28u);
     irq_baseline_masking();
-    pit_init(100u);
+    interrupt_controller_setup();
+    clock_setup();
+    trace_init();
     keyboard_init();
+    vga_register_hotkeys();
+    irq_stats_init();
+    profile_init();
+    profiler_setup();
+    serial_enable_tx_irq();
     vga_clear();
+    kprintf_add_sink(serial_write);
+    kprintf_add_sink(vga_write);
+    console_setup();
 
+    serial_puts("[moon-kernel] string ops: ");
+    serial_puts(string_variant());
+    serial_puts("\n");
     serial_puts("[moon-kernel] IDT loaded (256 entries)\n");
     serial_puts("[moon-kernel] PIC remapped (0x20-0x2F)\n");
-    serial_puts("[moon-kernel] PIT IRQ0 enabled (100Hz)\n");
     serial_puts("[moon-kernel] Keyboard IRQ1 enabled\n");
+    serial_puts("[moon-kernel] COM1 IRQ4 transmit ring enabled\n");
     /* MoonBit runs with IRQs enabled so tick/keyboard polling works live. */
     /* Future critical sections should explicitly control IRQ state. */
     enable_interrupts();
@@ -54,8 +169,7 @@ void kernel_main(uint32_t multiboot_magic, uint32_t multiboot_info_addr) {
 
     (void)main(0, (char **)0);
 
-    serial_puts("[moon-kernel] MoonBit main returned\n");
-    vga_puts("[moon-kernel] MoonBit main returned\n");
+    kprintf("[moon-kernel] MoonBit main returned\n");
 
     cpu_idle_forever();
 }
@@ -0,0 +1,185 @@
+#include "kernel/multiboot.h"
+
+#include <stdint.h>
+
+#define MULTIBOOT_PAGE_SIZE 0x1000u
+#define MULTIBOOT_MAX_RESERVED 16u
+#define MULTIBOOT_ADDR_LIMIT 0x100000000ull
+
+struct multiboot_range {
+    uint64_t start;
+    uint64_t end;
+};
+
+extern uint8_t __kernel_end[];
+
+static const struct multiboot_info *g_multiboot_info;
+static struct multiboot_range g_reserved[MULTIBOOT_MAX_RESERVED];
+static uint32_t g_reserved_count;
+
+void multiboot_init(uint32_t magic, uint32_t info_addr) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || info_addr == 0u) {
+        g_multiboot_info = (const struct multiboot_info *)0;
+        return;
+    }
+    g_multiboot_info = (const struct multiboot_info *)(uintptr_t)info_addr;
+}
+
+const struct multiboot_info *multiboot_get_info(void) {
+    return g_multiboot_info;
+}
+
+static void reserve(uint64_t start, uint64_t length) {
+    if (length == 0u || g_reserved_count >= MULTIBOOT_MAX_RESERVED) {
+        return;
+    }
+    g_reserved[g_reserved_count].start = start;
+    g_reserved[g_reserved_count].end = start + length;
+    g_reserved_count++;
+}
+
+static uint32_t cstring_size(uint32_t addr) {
+    const char *s = (const char *)(uintptr_t)addr;
+    uint32_t n = 0u;
+
+    while (s[n] != '\0') {
+        ++n;
+    }
+    return n + 1u;
+}
+
+/* Everything the kernel may still read after the heap starts handing out memory. */
+static void collect_reserved(const struct multiboot_info *info) {
+    const struct multiboot_module *mods;
+    uint32_t i;
+
+    g_reserved_count = 0u;
+    reserve(0u, (uint64_t)(uintptr_t)__kernel_end);
+    reserve((uint64_t)(uintptr_t)info, sizeof(*info));
+
+    if ((info->flags & MULTIBOOT_INFO_CMDLINE) != 0u && info->cmdline != 0u) {
+        reserve(info->cmdline, cstring_size(info->cmdline));
+    }
+    if ((info->flags & MULTIBOOT_INFO_MEM_MAP) != 0u) {
+        reserve(info->mmap_addr, info->mmap_length);
+    }
+    if ((info->flags & MULTIBOOT_INFO_MODS) != 0u) {
+        mods = (const struct multiboot_module *)(uintptr_t)info->mods_addr;
+        reserve(info->mods_addr, (uint64_t)info->mods_count * sizeof(*mods));
+        for (i = 0u; i < info->mods_count; ++i) {
+            if (mods[i].mod_end > mods[i].mod_start) {
+                reserve(mods[i].mod_start, mods[i].mod_end - mods[i].mod_start);
+            }
+        }
+    }
+}
+
+/* Updates the best candidate with the largest piece of [start, end) outside reserved ranges. */
+static void consider_range(uint64_t start, uint64_t end, struct multiboot_range *best) {
+    uint64_t cut_start;
+    uint64_t cut_end;
+    uint32_t i;
+
+    while (start < end) {
+        cut_start = end;
+        cut_end = end;
+        for (i = 0u; i < g_reserved_count; ++i) {
+            if (g_reserved[i].end > start && g_reserved[i].start < end && g_reserved[i].start < cut_start) {
+                cut_start = g_reserved[i].start;
+                cut_end = g_reserved[i].end;
+            }
+        }
+
+        if (cut_start <= start) {
+            /* A reserved range covers `start`; skip to its end. */
+            start = cut_end;
+            continue;
+        }
+
+        if (cut_start - start > best->end - best->start) {
+            best->start = start;
+            best->end = cut_start;
+        }
+        start = cut_end;
+    }
+}
+
+int multiboot_largest_free_region(uintptr_t *base, uintptr_t *length) {
+    const struct multiboot_info *info = g_multiboot_info;
+    const uint8_t *cursor;
+    const uint8_t *limit;
+    const struct multiboot_mmap_entry *entry;
+    struct multiboot_range best;
+    uint64_t start;
+    uint64_t end;
+
+    if (info == (const struct multiboot_info *)0) {
+        return 0;
+    }
+
+    collect_reserved(info);
+    best.start = 0u;
+    best.end = 0u;
+
+    if ((info->flags & MULTIBOOT_INFO_MEM_MAP) != 0u) {
+        cursor = (const uint8_t *)(uintptr_t)info->mmap_addr;
+        limit = cursor + info->mmap_length;
+        while (cursor + sizeof(*entry) <= limit) {
+            entry = (const struct multiboot_mmap_entry *)(const void *)cursor;
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE && entry->addr < MULTIBOOT_ADDR_LIMIT) {
+                start = entry->addr;
+                end = entry->addr + entry->len;
+                if (end > MULTIBOOT_ADDR_LIMIT) {
+                    end = MULTIBOOT_ADDR_LIMIT;
+                }
+                consider_range(start, end, &best);
+            }
+            cursor += entry->size + sizeof(entry->size);
+        }
+    } else if ((info->flags & MULTIBOOT_INFO_MEMORY) != 0u) {
+        /* No map: mem_upper is the contiguous KiB count starting at 1 MiB. */
+        consider_range(0x100000u, 0x100000u + (uint64_t)info->mem_upper * 1024u, &best);
+    }
+
+    best.start = (best.start + (MULTIBOOT_PAGE_SIZE - 1u)) & ~(uint64_t)(MULTIBOOT_PAGE_SIZE - 1u);
+    best.end &= ~(uint64_t)(MULTIBOOT_PAGE_SIZE - 1u);
+    if (best.end <= best.start) {
+        return 0;
+    }
+
+    /* Keep the end representable in a 32-bit uintptr_t. */
+    if (best.end > MULTIBOOT_ADDR_LIMIT - MULTIBOOT_PAGE_SIZE) {
+        best.end = MULTIBOOT_ADDR_LIMIT - MULTIBOOT_PAGE_SIZE;
+    }
+
+    *base = (uintptr_t)best.start;
+    *length = (uintptr_t)(best.end - best.start);
+    return 1;
+}
+
+int multiboot_cmdline_has_option(const char *option) {
+    const struct multiboot_info *info = g_multiboot_info;
+    const char *word;
+    uint32_t i;
+
+    if (info == (const struct multiboot_info *)0 || (info->flags & MULTIBOOT_INFO_CMDLINE) == 0u ||
+        info->cmdline == 0u) {
+        return 0;
+    }
+
+    word = (const char *)(uintptr_t)info->cmdline;
+    while (*word != '\0') {
+        while (*word == ' ') {
+            ++word;
+        }
+        for (i = 0u; option[i] != '\0' && word[i] == option[i]; ++i) {
+        }
+        if (option[i] == '\0' && (word[i] == ' ' || word[i] == '\0')) {
+            return 1;
+        }
+        while (*word != ' ' && *word != '\0') {
+            ++word;
+        }
+    }
+    return 0;
+}
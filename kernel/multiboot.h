@@ -0,0 +1,74 @@
+#ifndef KERNEL_MULTIBOOT_H
+#define KERNEL_MULTIBOOT_H
+
+#include <stdint.h>
+
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002u
+
+#define MULTIBOOT_INFO_MEMORY 0x00000001u
+#define MULTIBOOT_INFO_CMDLINE 0x00000004u
+#define MULTIBOOT_INFO_MODS 0x00000008u
+#define MULTIBOOT_INFO_MEM_MAP 0x00000040u
+#define MULTIBOOT_INFO_FRAMEBUFFER 0x00001000u
+
+#define MULTIBOOT_MEMORY_AVAILABLE 1u
+
+struct multiboot_info {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+    uint32_t apm_table;
+    uint32_t vbe_control_info;
+    uint32_t vbe_mode_info;
+    uint16_t vbe_mode;
+    uint16_t vbe_interface_seg;
+    uint16_t vbe_interface_off;
+    uint16_t vbe_interface_len;
+    uint64_t framebuffer_addr;
+    uint32_t framebuffer_pitch;
+    uint32_t framebuffer_width;
+    uint32_t framebuffer_height;
+    uint8_t framebuffer_bpp;
+    uint8_t framebuffer_type;
+} __attribute__((packed));
+
+/* `size` covers the entry without the size field itself. */
+struct multiboot_mmap_entry {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed));
+
+struct multiboot_module {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t cmdline;
+    uint32_t reserved;
+};
+
+void multiboot_init(uint32_t magic, uint32_t info_addr);
+const struct multiboot_info *multiboot_get_info(void);
+
+/*
+ * Finds the largest available memory-map range that does not overlap the
+ * kernel image (everything below __kernel_end) or the boot information
+ * itself. Returns 1 and a page-aligned range on success, 0 otherwise.
+ */
+int multiboot_largest_free_region(uintptr_t *base, uintptr_t *length);
+
+/* Returns 1 if `option` appears as a space-separated word on the kernel command line. */
+int multiboot_cmdline_has_option(const char *option);
+
+#endif
@@ -0,0 +1,166 @@
+#include "kernel/numfmt.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NUMFMT_BILLION 1000000000u
+
+/* "00".."99": two decimal digits per lookup, so the loop runs once per 100. */
+static const char dec_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* "00".."FF" in upper case; OR-ing 0x20 lowers A-F and leaves 0-9 unchanged. */
+static const char hex_pairs[513] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+/* Digit count from the bit length: log10(2) ~= 1233/4096, then one table compare. */
+static size_t u32_dec_len(uint32_t value) {
+    static const uint32_t pow10[10] = {1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u,
+                                       1000000000u};
+    uint32_t guess;
+
+    /* Setting bit 0 never changes the digit count and keeps clz defined. */
+    value |= 1u;
+    guess = ((uint32_t)(32 - __builtin_clz(value)) * 1233u) >> 12;
+    return (size_t)(guess + 1u - (value < pow10[guess] ? 1u : 0u));
+}
+
+/*
+ * Writes exactly `len` digits of `value` (zero-padded on the left) into
+ * buf[0, len). Division by the constant 100 compiles to a multiply by its
+ * reciprocal, so no div instruction runs here.
+ */
+static void put_dec(char *buf, size_t len, uint32_t value) {
+    char *p = buf + len;
+    const char *pair;
+    uint32_t q;
+
+    while (p - buf >= 2) {
+        q = value / 100u;
+        pair = &dec_pairs[(value - q * 100u) * 2u];
+        p -= 2;
+        p[0] = pair[0];
+        p[1] = pair[1];
+        value = q;
+    }
+    if (p > buf) {
+        *--p = (char)('0' + value);
+    }
+}
+
+/* Writes exactly `len` hex digits of `value` into buf[0, len). */
+static void put_hex(char *buf, size_t len, uint32_t value, char case_bit) {
+    char *p = buf + len;
+    const char *pair;
+
+    while (p - buf >= 2) {
+        pair = &hex_pairs[(value & 0xFFu) * 2u];
+        p -= 2;
+        p[0] = (char)(pair[0] | case_bit);
+        p[1] = (char)(pair[1] | case_bit);
+        value >>= 8;
+    }
+    if (p > buf) {
+        *--p = (char)(hex_pairs[(value & 0x0Fu) * 2u + 1u] | case_bit);
+    }
+}
+
+/*
+ * Divides *value by a 32-bit divisor in place and returns the remainder.
+ * i386 has no 64/64 divide and the kernel links without libgcc, so the
+ * quotient is built from two 64/32 divl steps (high word, then remainder:low).
+ */
+static uint32_t div_u64_u32(uint64_t *value, uint32_t divisor) {
+#if defined(__i386__)
+    uint32_t hi = (uint32_t)(*value >> 32);
+    uint32_t lo = (uint32_t)*value;
+    uint32_t q_hi = hi / divisor;
+    uint32_t rem = hi % divisor;
+    uint32_t q_lo;
+
+    __asm__("divl %4" : "=a"(q_lo), "=d"(rem) : "0"(lo), "1"(rem), "rm"(divisor));
+    *value = ((uint64_t)q_hi << 32) | q_lo;
+    return rem;
+#else
+    uint32_t rem = (uint32_t)(*value % divisor);
+
+    *value /= divisor;
+    return rem;
+#endif
+}
+
+size_t numfmt_u32_dec(char *buf, uint32_t value) {
+    size_t len = u32_dec_len(value);
+
+    put_dec(buf, len, value);
+    return len;
+}
+
+size_t numfmt_i32_dec(char *buf, int32_t value) {
+    if (value < 0) {
+        buf[0] = '-';
+        return 1u + numfmt_u32_dec(buf + 1, 0u - (uint32_t)value);
+    }
+    return numfmt_u32_dec(buf, (uint32_t)value);
+}
+
+size_t numfmt_u64_dec(char *buf, uint64_t value) {
+    uint32_t low;
+    uint32_t mid;
+    size_t len;
+
+    if ((value >> 32) == 0u) {
+        return numfmt_u32_dec(buf, (uint32_t)value);
+    }
+
+    /* Peel off nine-digit chunks; what remains above them fits in 32 bits. */
+    low = div_u64_u32(&value, NUMFMT_BILLION);
+    if (value < NUMFMT_BILLION) {
+        len = numfmt_u32_dec(buf, (uint32_t)value);
+        put_dec(buf + len, 9u, low);
+        return len + 9u;
+    }
+    mid = div_u64_u32(&value, NUMFMT_BILLION);
+    len = numfmt_u32_dec(buf, (uint32_t)value);
+    put_dec(buf + len, 9u, mid);
+    put_dec(buf + len + 9u, 9u, low);
+    return len + 18u;
+}
+
+size_t numfmt_i64_dec(char *buf, int64_t value) {
+    if (value < 0) {
+        buf[0] = '-';
+        return 1u + numfmt_u64_dec(buf + 1, 0u - (uint64_t)value);
+    }
+    return numfmt_u64_dec(buf, (uint64_t)value);
+}
+
+size_t numfmt_u32_hex(char *buf, uint32_t value, int upper) {
+    size_t len = (size_t)((35 - __builtin_clz(value | 1u)) / 4);
+
+    put_hex(buf, len, value, upper != 0 ? 0 : 0x20);
+    return len;
+}
+
+size_t numfmt_u64_hex(char *buf, uint64_t value, int upper) {
+    uint32_t hi = (uint32_t)(value >> 32);
+    size_t len;
+
+    if (hi == 0u) {
+        return numfmt_u32_hex(buf, (uint32_t)value, upper);
+    }
+    len = numfmt_u32_hex(buf, hi, upper);
+    put_hex(buf + len, 8u, (uint32_t)value, upper != 0 ? 0 : 0x20);
+    return len + 8u;
+}
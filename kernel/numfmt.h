@@ -0,0 +1,27 @@
+#ifndef KERNEL_NUMFMT_H
+#define KERNEL_NUMFMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Integer-to-text conversion into caller-provided buffers. Each function
+ * writes the digits (and a leading '-' for negative signed values) without a
+ * terminator and returns the count; buffers need the *_MAX bytes below.
+ */
+#define NUMFMT_U32_DEC_MAX 10u
+#define NUMFMT_I32_DEC_MAX 11u
+#define NUMFMT_U64_DEC_MAX 20u
+#define NUMFMT_I64_DEC_MAX 20u
+#define NUMFMT_U32_HEX_MAX 8u
+#define NUMFMT_U64_HEX_MAX 16u
+
+size_t numfmt_u32_dec(char *buf, uint32_t value);
+size_t numfmt_i32_dec(char *buf, int32_t value);
+size_t numfmt_u64_dec(char *buf, uint64_t value);
+size_t numfmt_i64_dec(char *buf, int64_t value);
+/* `upper` selects A-F over a-f; no "0x" prefix is written. */
+size_t numfmt_u32_hex(char *buf, uint32_t value, int upper);
+size_t numfmt_u64_hex(char *buf, uint64_t value, int upper);
+
+#endif
@@ -0,0 +1,178 @@
+#include "kernel/profile.h"
+
+#include <stdint.h>
+
+#include "arch/x86/clockevent.h"
+#include "arch/x86/irqflags.h"
+#include "arch/x86/isr_dispatch.h"
+#include "arch/x86/keyboard.h"
+#include "drivers/serial.h"
+#include "kernel/kprintf.h"
+#include "kernel/timer.h"
+
+#define KEY_F11 0x57u
+#define PROFILE_TICK_LINE 0u
+
+/* Bounds for the frame walk: the boot stack (arch/x86/multiboot_boot.s) and the kernel image (linker.ld). */
+extern char stack_bottom[];
+extern char stack_top[];
+extern char __text_start[];
+extern char __text_end[];
+
+static struct profile_sample g_samples[PROFILE_BUFFER_SAMPLES];
+/* Written only by the tick action; profile_dump() reads after stopping it. */
+static volatile uint32_t g_count;
+static volatile uint32_t g_dropped;
+static volatile int g_running;
+static uint32_t g_hz;
+static uint32_t g_period;
+static uint32_t g_last_tick;
+static struct irq_action g_tick_action;
+/* Keeps the one-shot tick firing at the sample period while idle; its callback does nothing. */
+static struct timer g_keepalive;
+/* F11 arrives in the keyboard softirq; dumping that much serial output waits for thread context. */
+static struct timer g_dump_timer;
+
+static int profile_return_address_ok(uint32_t addr) {
+    return addr >= (uint32_t)(uintptr_t)__text_start && addr < (uint32_t)(uintptr_t)__text_end;
+}
+
+/*
+ * Follows saved EBPs up the boot stack: [ebp] is the caller's EBP and
+ * [ebp + 4] the return address. Each frame must sit higher than the last,
+ * so a stray EBP ends the walk instead of looping.
+ */
+static uint32_t profile_walk(uint32_t ebp, uint32_t *callers) {
+    const uint32_t *frame;
+    uint32_t depth;
+
+    for (depth = 0u; depth < PROFILE_MAX_DEPTH; ++depth) {
+        if (ebp < (uint32_t)(uintptr_t)stack_bottom || ebp > (uint32_t)(uintptr_t)stack_top - 8u ||
+            (ebp & 3u) != 0u) {
+            break;
+        }
+        frame = (const uint32_t *)(uintptr_t)ebp;
+        if (profile_return_address_ok(frame[1]) == 0) {
+            break;
+        }
+        callers[depth] = frame[1];
+        if (frame[0] <= ebp) {
+            ++depth;
+            break;
+        }
+        ebp = frame[0];
+    }
+    return depth;
+}
+
+/* Runs after clockevent's handler on every IRQ0; the frame is the interrupted context. */
+static int profile_tick_action(uint8_t vector, const struct isr_frame *frame, void *arg) {
+    struct profile_sample *sample;
+    uint32_t tick;
+
+    (void)vector;
+    (void)arg;
+    if (g_running == 0) {
+        return IRQ_HANDLED;
+    }
+    tick = clockevent_ticks();
+    if (tick - g_last_tick < g_period) {
+        return IRQ_HANDLED;
+    }
+    g_last_tick = tick;
+    if (g_count >= PROFILE_BUFFER_SAMPLES) {
+        g_dropped++;
+        return IRQ_HANDLED;
+    }
+    sample = &g_samples[g_count];
+    sample->eip = frame->eip;
+    sample->depth = profile_walk(frame->ebp, sample->callers);
+    g_count++;
+    return IRQ_HANDLED;
+}
+
+static void profile_keepalive(struct timer *timer, void *arg) {
+    (void)timer;
+    (void)arg;
+}
+
+void profile_start(uint32_t hz) {
+    uint32_t tick_hz = clockevent_frequency();
+    uint32_t flags;
+
+    if (hz == 0u) {
+        hz = PROFILE_DEFAULT_HZ;
+    }
+    flags = irq_save_disable();
+    g_period = hz < tick_hz ? tick_hz / hz : 1u;
+    g_hz = tick_hz / g_period;
+    g_count = 0u;
+    g_dropped = 0u;
+    g_last_tick = clockevent_ticks();
+    g_running = 1;
+    timer_arm(&g_keepalive, g_period, g_period);
+    irq_restore(flags);
+}
+
+void profile_stop(void) {
+    uint32_t flags = irq_save_disable();
+
+    g_running = 0;
+    (void)timer_cancel(&g_keepalive);
+    irq_restore(flags);
+}
+
+int profile_running(void) {
+    return g_running;
+}
+
+uint32_t profile_sample_count(void) {
+    return g_count;
+}
+
+void profile_dump(void) {
+    const struct profile_sample *sample;
+    char line[128];
+    uint32_t i;
+    uint32_t depth;
+    int len;
+
+    profile_stop();
+    (void)ksnprintf(line, sizeof(line), "[prof] begin hz=%u samples=%u dropped=%u depth=%u\n", g_hz, g_count,
+                    g_dropped, PROFILE_MAX_DEPTH);
+    serial_puts(line);
+    /* One sample per line: the EIP, then return addresses innermost first. */
+    for (i = 0u; i < g_count; ++i) {
+        sample = &g_samples[i];
+        len = ksnprintf(line, sizeof(line), "[prof] %08x", sample->eip);
+        for (depth = 0u; depth < sample->depth; ++depth) {
+            len += ksnprintf(line + len, sizeof(line) - (uint32_t)len, " %08x", sample->callers[depth]);
+        }
+        (void)ksnprintf(line + len, sizeof(line) - (uint32_t)len, "\n");
+        serial_puts(line);
+    }
+    serial_puts("[prof] end\n");
+}
+
+static void profile_dump_expired(struct timer *timer, void *arg) {
+    (void)timer;
+    (void)arg;
+    profile_dump();
+}
+
+static void profile_hotkey(uint16_t key) {
+    (void)key;
+    if (g_running == 0) {
+        profile_start(PROFILE_DEFAULT_HZ);
+        return;
+    }
+    timer_arm(&g_dump_timer, 0u, 0u);
+}
+
+void profile_init(void) {
+    timer_setup(&g_keepalive, profile_keepalive, (void *)0);
+    timer_setup(&g_dump_timer, profile_dump_expired, (void *)0);
+    irq_action_init(&g_tick_action, profile_tick_action, (void *)0);
+    (void)isr_add_action((uint8_t)ISR_LINE_VECTOR(PROFILE_TICK_LINE), &g_tick_action);
+    (void)keyboard_register_hotkey(KEY_F11, 0u, profile_hotkey);
+}
@@ -0,0 +1,37 @@
+#ifndef KERNEL_PROFILE_H
+#define KERNEL_PROFILE_H
+
+#include <stdint.h>
+
+#define PROFILE_MAX_DEPTH 8u
+#define PROFILE_BUFFER_SAMPLES 2048u
+#define PROFILE_DEFAULT_HZ 100u
+
+/*
+ * Statistical profiler on the timer tick. Each sample is the interrupted
+ * EIP plus up to PROFILE_MAX_DEPTH return addresses from the saved-EBP
+ * chain. The chain is only trustworthy in a PROFILE=1 build
+ * (-fno-omit-frame-pointer); otherwise it stops at the first EBP that does
+ * not point into the boot stack. Sampling stops when the buffer is full.
+ */
+struct profile_sample {
+    uint32_t eip;
+    uint32_t depth;
+    uint32_t callers[PROFILE_MAX_DEPTH];
+};
+
+/* Hooks the IRQ0 chain and registers F11 (start, or stop and dump). Call after clockevent_init(). */
+void profile_init(void);
+/*
+ * Clears the buffer and samples every tick_hz / hz ticks (at least every
+ * tick). The tick keeps running while idle so idle time is sampled too.
+ */
+void profile_start(uint32_t hz);
+void profile_stop(void);
+int profile_running(void);
+uint32_t profile_sample_count(void);
+
+/* Writes "[prof]" lines over serial for tools/profile_symbolize.py. Stops sampling first. Thread context. */
+void profile_dump(void);
+
+#endif
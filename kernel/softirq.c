@@ -0,0 +1,138 @@
+#include "kernel/softirq.h"
+
+#include <stdint.h>
+
+#include "arch/x86/cpu.h"
+#include "arch/x86/irqflags.h"
+
+/* Queue batches per drain; what is left waits for the next IRQ exit or the idle loop. */
+#define SOFTIRQ_MAX_PASSES 8u
+
+/*
+ * One push-only LIFO per priority. Producers CAS onto the head; the single
+ * consumer takes the whole list with one xchg, so there is no pop and no
+ * ABA. g_running keeps the consumer single on this uniprocessor kernel.
+ */
+static struct softirq_work *volatile g_queues[SOFTIRQ_PRIORITIES];
+static volatile int g_running;
+static struct softirq_stats g_stats[SOFTIRQ_PRIORITIES];
+
+void softirq_work_init(struct softirq_work *work, softirq_fn fn, void *arg, uint32_t priority) {
+    work->next = (struct softirq_work *)0;
+    work->fn = fn;
+    work->arg = arg;
+    work->queued = 0u;
+    work->priority = priority < SOFTIRQ_PRIORITIES ? priority : SOFTIRQ_PRIO_LOW;
+}
+
+int softirq_raise(struct softirq_work *work) {
+    struct softirq_work *head;
+
+    if (__sync_bool_compare_and_swap(&work->queued, 0u, 1u) == 0) {
+        return 0;
+    }
+    do {
+        head = g_queues[work->priority];
+        work->next = head;
+    } while (__sync_bool_compare_and_swap(&g_queues[work->priority], head, work) == 0);
+    return 1;
+}
+
+int softirq_pending(void) {
+    uint32_t priority;
+
+    for (priority = 0u; priority < SOFTIRQ_PRIORITIES; ++priority) {
+        if (g_queues[priority] != (struct softirq_work *)0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void softirq_run_list(uint32_t priority, struct softirq_work *list) {
+    struct softirq_stats *stats = &g_stats[priority];
+    struct softirq_work *fifo;
+    struct softirq_work *work;
+    uint64_t start;
+    uint64_t cycles;
+    int timed;
+
+    /* The list comes off the stack newest first; run it in raise order. */
+    fifo = (struct softirq_work *)0;
+    while (list != (struct softirq_work *)0) {
+        work = list;
+        list = work->next;
+        work->next = fifo;
+        fifo = work;
+    }
+
+    timed = cpu_has_feature(CPU_FEATURE_TSC);
+    while ((work = fifo) != (struct softirq_work *)0) {
+        fifo = work->next;
+        /* Cleared first so an IRQ during fn() can queue it again. */
+        __sync_lock_release(&work->queued);
+        start = timed != 0 ? cpu_rdtsc() : 0u;
+        work->fn(work->arg);
+        stats->runs++;
+        if (timed != 0) {
+            cycles = cpu_rdtsc() - start;
+            stats->total_cycles += cycles;
+            if (cycles > stats->max_cycles) {
+                stats->max_cycles = (cycles >> 32) != 0u ? 0xFFFFFFFFu : (uint32_t)cycles;
+            }
+        }
+    }
+}
+
+static void softirq_drain(void) {
+    struct softirq_work *list;
+    uint32_t priority;
+    uint32_t pass;
+
+    for (pass = 0u; pass < SOFTIRQ_MAX_PASSES; ++pass) {
+        for (priority = 0u; priority < SOFTIRQ_PRIORITIES && g_queues[priority] == (struct softirq_work *)0;
+             ++priority) {
+        }
+        if (priority == SOFTIRQ_PRIORITIES) {
+            return;
+        }
+        list = __sync_lock_test_and_set(&g_queues[priority], (struct softirq_work *)0);
+        softirq_run_list(priority, list);
+    }
+}
+
+void softirq_irq_exit(void) {
+    /* Nested in an IRQ that interrupted a drain: the outer drain picks the work up. */
+    if (g_running != 0 || softirq_pending() == 0) {
+        return;
+    }
+    g_running = 1;
+    irq_enable();
+    softirq_drain();
+    irq_disable();
+    g_running = 0;
+}
+
+void softirq_run(void) {
+    uint32_t flags = irq_save_disable();
+
+    if (g_running != 0) {
+        irq_restore(flags);
+        return;
+    }
+    g_running = 1;
+    irq_restore(flags);
+    softirq_drain();
+    g_running = 0;
+}
+
+void softirq_get_stats(uint32_t priority, struct softirq_stats *stats) {
+    uint32_t flags;
+
+    if (priority >= SOFTIRQ_PRIORITIES) {
+        priority = SOFTIRQ_PRIO_LOW;
+    }
+    flags = irq_save_disable();
+    *stats = g_stats[priority];
+    irq_restore(flags);
+}
@@ -0,0 +1,54 @@
+#ifndef KERNEL_SOFTIRQ_H
+#define KERNEL_SOFTIRQ_H
+
+#include <stdint.h>
+
+/* Lower value runs first; each drain pass restarts from SOFTIRQ_PRIO_HIGH. */
+#define SOFTIRQ_PRIO_HIGH 0u
+#define SOFTIRQ_PRIO_NORMAL 1u
+#define SOFTIRQ_PRIO_LOW 2u
+#define SOFTIRQ_PRIORITIES 3u
+
+typedef void (*softirq_fn)(void *arg);
+
+/*
+ * Deferred interrupt work (bottom half). A top half acknowledges its device
+ * and calls softirq_raise(); the work then runs once, after EOI with
+ * interrupts enabled, from the outermost IRQ exit or from the idle loop.
+ * Work never runs concurrently with itself or other work, but IRQ handlers
+ * may interrupt it. Storage belongs to the caller.
+ */
+struct softirq_work {
+    struct softirq_work *next;
+    softirq_fn fn;
+    void *arg;
+    volatile uint32_t queued;
+    uint32_t priority;
+};
+
+struct softirq_stats {
+    uint32_t runs;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+};
+
+void softirq_work_init(struct softirq_work *work, softirq_fn fn, void *arg, uint32_t priority);
+/*
+ * Queues `work` on its priority's lock-free list; safe from any context.
+ * Returns 0 if it was already queued (it still runs once). A work item may
+ * re-raise itself.
+ */
+int softirq_raise(struct softirq_work *work);
+int softirq_pending(void);
+
+/*
+ * Called by isr_common_handler() after the outermost handler's EOI, with
+ * interrupts disabled; returns with them disabled.
+ */
+void softirq_irq_exit(void);
+/* Drains queued work from thread context (the idle loop). */
+void softirq_run(void);
+
+void softirq_get_stats(uint32_t priority, struct softirq_stats *stats);
+
+#endif
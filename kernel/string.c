@@ -0,0 +1,439 @@
+#include "kernel/string.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arch/x86/cpu.h"
+
+/*
+ * Freestanding mem and str routines shared by both kernel paths.
+ *
+ * Short operations stay in plain loops. From STRING_REP_MIN bytes on, the
+ * copy/fill runs with `rep movsl`/`rep stosl` after aligning the destination;
+ * from STRING_BULK_MIN bytes on, it goes through the bulk kernel chosen once
+ * by string_init() (SSE2 when cpu_init() enabled SSE, otherwise `rep`).
+ *
+ * Every forward copy walks ascending addresses and loads each unit before it
+ * stores it, which memmove relies on for dst < src overlaps.
+ *
+ * The interrupt stubs do not save FPU/SSE state, so the SSE2 kernels save and
+ * restore every XMM register they touch. That keeps them safe to call from IRQ
+ * handlers that interrupt another SSE2 copy.
+ */
+
+#define STRING_REP_MIN 16u
+#define STRING_BULK_MIN 256u
+
+typedef uint32_t __attribute__((may_alias, aligned(1))) string_word_t;
+
+static void *memcpy_rep(void *dst, const void *src, size_t n);
+static void *memset_rep(void *dst, int c, size_t n);
+static int memcmp_words(const uint8_t *a, const uint8_t *b, size_t n);
+static size_t strlen_words(const char *s);
+
+static void *(*g_memcpy_bulk)(void *, const void *, size_t) = memcpy_rep;
+static void *(*g_memset_bulk)(void *, int, size_t) = memset_rep;
+static int (*g_memcmp_bulk)(const uint8_t *, const uint8_t *, size_t) = memcmp_words;
+static size_t (*g_strlen)(const char *) = strlen_words;
+static const char *g_string_variant = "rep";
+
+static void *memcpy_rep(void *dst, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    size_t head;
+    size_t words;
+
+    head = (size_t)(-(uintptr_t)d & 3u);
+    if (head > n) {
+        head = n;
+    }
+    n -= head;
+    words = n >> 2;
+    n &= 3u;
+
+    __asm__ volatile(
+        "rep movsb\n\t"
+        "movl %3, %%ecx\n\t"
+        "rep movsl\n\t"
+        "movl %4, %%ecx\n\t"
+        "rep movsb"
+        : "+D"(d), "+S"(s), "+c"(head)
+        : "r"(words), "r"(n)
+        : "memory");
+    return dst;
+}
+
+static void *memset_rep(void *dst, int c, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    uint32_t pattern;
+    size_t head;
+    size_t words;
+
+    pattern = (uint32_t)(uint8_t)c * 0x01010101u;
+    head = (size_t)(-(uintptr_t)d & 3u);
+    if (head > n) {
+        head = n;
+    }
+    n -= head;
+    words = n >> 2;
+    n &= 3u;
+
+    __asm__ volatile(
+        "rep stosb\n\t"
+        "movl %3, %%ecx\n\t"
+        "rep stosl\n\t"
+        "movl %4, %%ecx\n\t"
+        "rep stosb"
+        : "+D"(d), "+c"(head)
+        : "a"(pattern), "r"(words), "r"(n)
+        : "memory");
+    return dst;
+}
+
+static void copy_backward(uint8_t *d, const uint8_t *s, size_t n) {
+    size_t words = n >> 2;
+    size_t tail = n & 3u;
+
+    d += n - 1u;
+    s += n - 1u;
+
+    /* Tail bytes first, then whole words down to the start; DF is restored. */
+    __asm__ volatile(
+        "std\n\t"
+        "rep movsb\n\t"
+        "subl $3, %%esi\n\t"
+        "subl $3, %%edi\n\t"
+        "movl %3, %%ecx\n\t"
+        "rep movsl\n\t"
+        "cld"
+        : "+D"(d), "+S"(s), "+c"(tail)
+        : "r"(words)
+        : "memory", "cc");
+}
+
+static int memcmp_words(const uint8_t *a, const uint8_t *b, size_t n) {
+    size_t i;
+
+    while (n >= 4u && *(const string_word_t *)(const void *)a == *(const string_word_t *)(const void *)b) {
+        a += 4;
+        b += 4;
+        n -= 4u;
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (a[i] != b[i]) {
+            return (int)a[i] - (int)b[i];
+        }
+    }
+    return 0;
+}
+
+static size_t strlen_words(const char *s) {
+    const char *p = s;
+    uint32_t word;
+
+    while (((uintptr_t)p & 3u) != 0u) {
+        if (*p == '\0') {
+            return (size_t)(p - s);
+        }
+        ++p;
+    }
+
+    /* Aligned word reads never cross a page, so reading past the NUL is safe. */
+    for (;;) {
+        word = *(const string_word_t *)(const void *)p;
+        if (((word - 0x01010101u) & ~word & 0x80808080u) != 0u) {
+            break;
+        }
+        p += 4;
+    }
+
+    while (*p != '\0') {
+        ++p;
+    }
+    return (size_t)(p - s);
+}
+
+static void *memcpy_sse2(void *dst, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t xmm_save[64];
+    size_t head;
+    size_t blocks;
+
+    head = (size_t)(-(uintptr_t)d & 15u);
+    memcpy_rep(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    blocks = n >> 6;
+    n &= 63u;
+    if (blocks != 0u) {
+        __asm__ volatile(
+            "movdqu %%xmm0, 0(%[save])\n\t"
+            "movdqu %%xmm1, 16(%[save])\n\t"
+            "movdqu %%xmm2, 32(%[save])\n\t"
+            "movdqu %%xmm3, 48(%[save])\n\t"
+            "1:\n\t"
+            "movdqu 0(%[s]), %%xmm0\n\t"
+            "movdqu 16(%[s]), %%xmm1\n\t"
+            "movdqu 32(%[s]), %%xmm2\n\t"
+            "movdqu 48(%[s]), %%xmm3\n\t"
+            "movdqa %%xmm0, 0(%[d])\n\t"
+            "movdqa %%xmm1, 16(%[d])\n\t"
+            "movdqa %%xmm2, 32(%[d])\n\t"
+            "movdqa %%xmm3, 48(%[d])\n\t"
+            "addl $64, %[s]\n\t"
+            "addl $64, %[d]\n\t"
+            "decl %[blocks]\n\t"
+            "jnz 1b\n\t"
+            "movdqu 0(%[save]), %%xmm0\n\t"
+            "movdqu 16(%[save]), %%xmm1\n\t"
+            "movdqu 32(%[save]), %%xmm2\n\t"
+            "movdqu 48(%[save]), %%xmm3"
+            : [d] "+r"(d), [s] "+r"(s), [blocks] "+r"(blocks)
+            : [save] "r"(xmm_save)
+            : "memory", "cc");
+    }
+
+    memcpy_rep(d, s, n);
+    return dst;
+}
+
+static void *memset_sse2(void *dst, int c, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    uint32_t pattern[4];
+    uint8_t xmm_save[16];
+    size_t head;
+    size_t blocks;
+
+    head = (size_t)(-(uintptr_t)d & 15u);
+    memset_rep(d, c, head);
+    d += head;
+    n -= head;
+
+    pattern[0] = (uint32_t)(uint8_t)c * 0x01010101u;
+    pattern[1] = pattern[0];
+    pattern[2] = pattern[0];
+    pattern[3] = pattern[0];
+
+    blocks = n >> 6;
+    n &= 63u;
+    if (blocks != 0u) {
+        __asm__ volatile(
+            "movdqu %%xmm0, (%[save])\n\t"
+            "movdqu (%[pattern]), %%xmm0\n\t"
+            "1:\n\t"
+            "movdqa %%xmm0, 0(%[d])\n\t"
+            "movdqa %%xmm0, 16(%[d])\n\t"
+            "movdqa %%xmm0, 32(%[d])\n\t"
+            "movdqa %%xmm0, 48(%[d])\n\t"
+            "addl $64, %[d]\n\t"
+            "decl %[blocks]\n\t"
+            "jnz 1b\n\t"
+            "movdqu (%[save]), %%xmm0"
+            : [d] "+r"(d), [blocks] "+r"(blocks)
+            : [save] "r"(xmm_save), [pattern] "r"(pattern)
+            : "memory", "cc");
+    }
+
+    memset_rep(d, c, n);
+    return dst;
+}
+
+static int memcmp_sse2(const uint8_t *a, const uint8_t *b, size_t n) {
+    uint8_t xmm_save[32];
+    uint32_t mask;
+
+    __asm__ volatile(
+        "movdqu %%xmm0, 0(%0)\n\t"
+        "movdqu %%xmm1, 16(%0)"
+        :
+        : "r"(xmm_save)
+        : "memory");
+
+    while (n >= 16u) {
+        __asm__ volatile(
+            "movdqu (%1), %%xmm0\n\t"
+            "movdqu (%2), %%xmm1\n\t"
+            "pcmpeqb %%xmm1, %%xmm0\n\t"
+            "pmovmskb %%xmm0, %0"
+            : "=r"(mask)
+            : "r"(a), "r"(b)
+            : "memory");
+        if (mask != 0xFFFFu) {
+            break;
+        }
+        a += 16;
+        b += 16;
+        n -= 16u;
+    }
+
+    __asm__ volatile(
+        "movdqu 0(%0), %%xmm0\n\t"
+        "movdqu 16(%0), %%xmm1"
+        :
+        : "r"(xmm_save)
+        : "memory");
+
+    /* Either fewer than 16 bytes remain or the difference is in the next 16. */
+    return memcmp_words(a, b, n);
+}
+
+static size_t strlen_sse2(const char *s) {
+    const uint8_t *p;
+    uint8_t xmm_save[32];
+    uint32_t mask;
+
+    p = (const uint8_t *)((uintptr_t)s & ~(uintptr_t)15u);
+
+    __asm__ volatile(
+        "movdqu %%xmm0, 0(%0)\n\t"
+        "movdqu %%xmm1, 16(%0)\n\t"
+        "pxor %%xmm1, %%xmm1"
+        :
+        : "r"(xmm_save)
+        : "memory");
+
+    /* Aligned 16-byte loads never cross a page boundary. */
+    __asm__ volatile(
+        "movdqa (%1), %%xmm0\n\t"
+        "pcmpeqb %%xmm1, %%xmm0\n\t"
+        "pmovmskb %%xmm0, %0"
+        : "=r"(mask)
+        : "r"(p)
+        : "memory");
+    mask &= 0xFFFFu << ((uintptr_t)s & 15u);
+
+    while (mask == 0u) {
+        p += 16;
+        __asm__ volatile(
+            "movdqa (%1), %%xmm0\n\t"
+            "pcmpeqb %%xmm1, %%xmm0\n\t"
+            "pmovmskb %%xmm0, %0"
+            : "=r"(mask)
+            : "r"(p)
+            : "memory");
+    }
+
+    __asm__ volatile(
+        "movdqu 0(%0), %%xmm0\n\t"
+        "movdqu 16(%0), %%xmm1"
+        :
+        : "r"(xmm_save)
+        : "memory");
+
+    return (size_t)((const char *)p + __builtin_ctz(mask) - s);
+}
+
+void string_init(void) {
+    if (cpu_has_feature(CPU_FEATURE_SSE2 | CPU_FEATURE_SSE_ENABLED) != 0) {
+        g_memcpy_bulk = memcpy_sse2;
+        g_memset_bulk = memset_sse2;
+        g_memcmp_bulk = memcmp_sse2;
+        g_strlen = strlen_sse2;
+        g_string_variant = "sse2";
+        return;
+    }
+
+    g_memcpy_bulk = memcpy_rep;
+    g_memset_bulk = memset_rep;
+    g_memcmp_bulk = memcmp_words;
+    g_strlen = strlen_words;
+    g_string_variant = "rep";
+}
+
+const char *string_variant(void) {
+    return g_string_variant;
+}
+
+void *memset(void *dst, int c, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    size_t i;
+
+    if (n >= STRING_BULK_MIN) {
+        return g_memset_bulk(dst, c, n);
+    }
+    if (n >= STRING_REP_MIN) {
+        return memset_rep(dst, c, n);
+    }
+
+    for (i = 0; i < n; ++i) {
+        d[i] = (uint8_t)c;
+    }
+    return dst;
+}
+
+void *memcpy(void *dst, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    size_t i;
+
+    if (n >= STRING_BULK_MIN) {
+        return g_memcpy_bulk(dst, src, n);
+    }
+    if (n >= STRING_REP_MIN) {
+        return memcpy_rep(dst, src, n);
+    }
+
+    for (i = 0; i < n; ++i) {
+        d[i] = s[i];
+    }
+    return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+
+    if (d == s || n == 0u) {
+        return dst;
+    }
+
+    /* dst below src, or no overlap at all: an ascending copy is safe. */
+    if ((uintptr_t)d - (uintptr_t)s >= n) {
+        return memcpy(dst, src, n);
+    }
+
+    copy_backward(d, s, n);
+    return dst;
+}
+
+int memcmp(const void *lhs, const void *rhs, size_t n) {
+    const uint8_t *a = (const uint8_t *)lhs;
+    const uint8_t *b = (const uint8_t *)rhs;
+
+    if (n >= STRING_BULK_MIN) {
+        return g_memcmp_bulk(a, b, n);
+    }
+    return memcmp_words(a, b, n);
+}
+
+size_t strlen(const char *s) {
+    return g_strlen(s);
+}
+
+int strcmp(const char *s1, const char *s2) {
+    while (*s1 != '\0' && *s1 == *s2) {
+        ++s1;
+        ++s2;
+    }
+    return (int)(unsigned char)*s1 - (int)(unsigned char)*s2;
+}
+
+int strncmp(const char *s1, const char *s2, size_t n) {
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        unsigned char c1 = (unsigned char)s1[i];
+        unsigned char c2 = (unsigned char)s2[i];
+        if (c1 != c2) {
+            return (int)c1 - (int)c2;
+        }
+        if (c1 == '\0') {
+            return 0;
+        }
+    }
+    return 0;
+}
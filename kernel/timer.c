@@ -0,0 +1,313 @@
+#include "kernel/timer.h"
+
+#include <stdint.h>
+
+#include "arch/x86/clockevent.h"
+#include "arch/x86/cpu.h"
+#include "arch/x86/irqflags.h"
+#include "kernel/klog.h"
+
+#define TIMER_LEVELS 4u
+#define TIMER_LEVEL_BITS 6u
+#define TIMER_LEVEL_SIZE (1u << TIMER_LEVEL_BITS)
+#define TIMER_LEVEL_MASK (TIMER_LEVEL_SIZE - 1u)
+/* Furthest expiry the top level holds; later ones are parked there and re-filed on cascade. */
+#define TIMER_MAX_DELTA ((1u << (TIMER_LEVELS * TIMER_LEVEL_BITS)) - 1u)
+/* Bucket of a timer that timer_run() has taken off the wheel but not yet fired. */
+#define TIMER_BUCKET_RUNNING 0xFFFFu
+
+/*
+ * Classic cascading wheel: level L slot s holds timers due within the
+ * 64^L-tick span s; when the level below wraps, the slot is re-filed into
+ * finer levels. Slots are singly linked with a back pointer (pprev) so
+ * unlinking needs no list head and the zeroed BSS is an empty wheel.
+ */
+static struct timer *g_wheel[TIMER_LEVELS * TIMER_LEVEL_SIZE];
+static uint64_t g_occupied[TIMER_LEVELS];
+/* Next tick the wheel will process. */
+static uint32_t g_clk;
+static volatile uint32_t g_next_expiry;
+static volatile uint32_t g_armed;
+static volatile int g_due;
+
+static uint32_t g_fired;
+static uint32_t g_cascaded;
+static uint64_t g_slack_total_ns;
+static uint32_t g_slack_max_ns;
+
+static void wheel_link(struct timer **head, struct timer *timer) {
+    timer->next = *head;
+    if (timer->next != (struct timer *)0) {
+        timer->next->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void wheel_unlink(struct timer *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next != (struct timer *)0) {
+        timer->next->pprev = timer->pprev;
+    }
+    if (timer->bucket != TIMER_BUCKET_RUNNING && g_wheel[timer->bucket] == (struct timer *)0) {
+        g_occupied[timer->bucket / TIMER_LEVEL_SIZE] &= ~((uint64_t)1u << (timer->bucket % TIMER_LEVEL_SIZE));
+    }
+    timer->next = (struct timer *)0;
+    timer->pprev = (struct timer **)0;
+}
+
+static void wheel_add(struct timer *timer) {
+    uint32_t expires = timer->expires;
+    uint32_t delta = expires - g_clk;
+    uint32_t level;
+    uint32_t slot;
+
+    if ((int32_t)delta < 0) {
+        /* Already due: the slot processed next. */
+        expires = g_clk;
+        delta = 0u;
+    } else if (delta > TIMER_MAX_DELTA) {
+        expires = g_clk + TIMER_MAX_DELTA;
+        delta = TIMER_MAX_DELTA;
+    }
+    for (level = 0u; level + 1u < TIMER_LEVELS && delta >= (1u << ((level + 1u) * TIMER_LEVEL_BITS)); ++level) {
+    }
+    slot = (expires >> (level * TIMER_LEVEL_BITS)) & TIMER_LEVEL_MASK;
+    timer->bucket = (uint16_t)(level * TIMER_LEVEL_SIZE + slot);
+    wheel_link(&g_wheel[timer->bucket], timer);
+    g_occupied[level] |= (uint64_t)1u << slot;
+}
+
+/* Distance from `start` to the first occupied slot of `level` at or after it (wrapping); TIMER_LEVEL_SIZE if none. */
+static uint32_t level_scan(uint32_t level, uint32_t start) {
+    uint64_t bits = g_occupied[level];
+    uint32_t low;
+
+    if (bits == 0u) {
+        return TIMER_LEVEL_SIZE;
+    }
+    if (start != 0u) {
+        bits = (bits >> start) | (bits << (TIMER_LEVEL_SIZE - start));
+    }
+    low = (uint32_t)bits;
+    return low != 0u ? (uint32_t)__builtin_ctz(low) : 32u + (uint32_t)__builtin_ctz((uint32_t)(bits >> 32));
+}
+
+/*
+ * Earliest tick at which the wheel expires or cascades anything: a lower
+ * bound on the next expiry that costs four bitmap scans.
+ */
+static uint32_t wheel_next_event(void) {
+    uint32_t best = TIMER_MAX_DELTA + 1u;
+    uint32_t shift;
+    uint32_t index;
+    uint32_t base;
+    uint32_t dist;
+    uint32_t level;
+
+    dist = level_scan(0u, g_clk & TIMER_LEVEL_MASK);
+    if (dist < TIMER_LEVEL_SIZE) {
+        best = dist;
+    }
+    for (level = 1u; level < TIMER_LEVELS; ++level) {
+        shift = level * TIMER_LEVEL_BITS;
+        index = (g_clk >> shift) & TIMER_LEVEL_MASK;
+        base = g_clk & ~((1u << shift) - 1u);
+        /* On a boundary the current slot's cascade is still pending at g_clk. */
+        if (base == g_clk && (g_occupied[level] & ((uint64_t)1u << index)) != 0u) {
+            return g_clk;
+        }
+        dist = level_scan(level, (index + 1u) & TIMER_LEVEL_MASK);
+        if (dist < TIMER_LEVEL_SIZE && base + ((dist + 1u) << shift) - g_clk < best) {
+            best = base + ((dist + 1u) << shift) - g_clk;
+        }
+    }
+    return g_clk + best;
+}
+
+/* Re-files the slots of coarser levels whose span starts at g_clk. */
+static void wheel_cascade(void) {
+    struct timer *list;
+    struct timer *timer;
+    uint32_t level;
+    uint32_t bucket;
+
+    for (level = 1u; level < TIMER_LEVELS && (g_clk & ((1u << (level * TIMER_LEVEL_BITS)) - 1u)) == 0u; ++level) {
+        bucket = level * TIMER_LEVEL_SIZE + ((g_clk >> (level * TIMER_LEVEL_BITS)) & TIMER_LEVEL_MASK);
+        list = g_wheel[bucket];
+        g_wheel[bucket] = (struct timer *)0;
+        g_occupied[level] &= ~((uint64_t)1u << (bucket % TIMER_LEVEL_SIZE));
+        while (list != (struct timer *)0) {
+            timer = list;
+            list = timer->next;
+            wheel_add(timer);
+            g_cascaded++;
+        }
+    }
+}
+
+static void timer_account_slack(uint32_t expires) {
+    uint64_t slack = clockevent_ns_since_tick(expires);
+    uint32_t slack32 = (slack >> 32) != 0u ? 0xFFFFFFFFu : (uint32_t)slack;
+
+    g_fired++;
+    g_slack_total_ns += slack32;
+    if (slack32 > g_slack_max_ns) {
+        g_slack_max_ns = slack32;
+    }
+}
+
+void timer_setup(struct timer *timer, timer_fn fn, void *arg) {
+    timer->next = (struct timer *)0;
+    timer->pprev = (struct timer **)0;
+    timer->expires = 0u;
+    timer->period = 0u;
+    timer->bucket = 0u;
+    timer->fn = fn;
+    timer->arg = arg;
+}
+
+void timer_arm(struct timer *timer, uint32_t delay, uint32_t period) {
+    uint32_t flags = irq_save_disable();
+    uint32_t now = clockevent_ticks();
+
+    if (timer->pprev != (struct timer **)0) {
+        wheel_unlink(timer);
+        g_armed--;
+    }
+    /* An empty wheel may lag the tick count arbitrarily; restart it at the current tick. */
+    if (g_armed == 0u) {
+        g_clk = now;
+    }
+    timer->expires = now + delay;
+    timer->period = period;
+    wheel_add(timer);
+    if (g_armed++ == 0u || (int32_t)(timer->expires - g_next_expiry) < 0) {
+        g_next_expiry = timer->expires;
+    }
+    if (delay == 0u) {
+        g_due = 1;
+    }
+    irq_restore(flags);
+}
+
+int timer_cancel(struct timer *timer) {
+    uint32_t flags = irq_save_disable();
+    int was_armed = timer->pprev != (struct timer **)0;
+
+    if (was_armed != 0) {
+        wheel_unlink(timer);
+        g_armed--;
+    }
+    irq_restore(flags);
+    return was_armed;
+}
+
+int timer_armed(const struct timer *timer) {
+    return timer->pprev != (struct timer **)0;
+}
+
+uint32_t timer_ms_to_ticks(uint32_t ms) {
+    uint32_t hz = clockevent_frequency();
+
+    if (hz == 0u) {
+        hz = 100u;
+    }
+    return cpu_div64_32((uint64_t)ms * hz + 999u, 1000u, (uint32_t *)0);
+}
+
+void timer_tick(uint32_t tick) {
+    if (g_armed != 0u && (int32_t)(tick - g_next_expiry) >= 0) {
+        g_due = 1;
+    }
+}
+
+int timer_pending(void) {
+    return g_due;
+}
+
+void timer_run(void) {
+    struct timer *work;
+    struct timer *timer;
+    uint32_t flags;
+    uint32_t now;
+    uint32_t next;
+    uint32_t expires;
+    uint32_t slot;
+
+    flags = irq_save_disable();
+    g_due = 0;
+    now = clockevent_ticks();
+    while ((int32_t)(now - g_clk) >= 0) {
+        if (g_armed == 0u) {
+            g_clk = now + 1u;
+            break;
+        }
+        /* Jump over ticks in which nothing expires or cascades. */
+        next = wheel_next_event();
+        if ((int32_t)(next - g_clk) > 0) {
+            g_clk = (int32_t)(next - now) > 0 ? now + 1u : next;
+            continue;
+        }
+
+        wheel_cascade();
+        slot = g_clk & TIMER_LEVEL_MASK;
+        work = g_wheel[slot];
+        g_wheel[slot] = (struct timer *)0;
+        g_occupied[0] &= ~((uint64_t)1u << slot);
+        if (work != (struct timer *)0) {
+            work->pprev = &work;
+        }
+        for (timer = work; timer != (struct timer *)0; timer = timer->next) {
+            timer->bucket = TIMER_BUCKET_RUNNING;
+        }
+        g_clk++;
+
+        /* Pop one at a time so callbacks may cancel or re-arm anything still on `work`. */
+        while ((timer = work) != (struct timer *)0) {
+            wheel_unlink(timer);
+            g_armed--;
+            expires = timer->expires;
+            if (timer->period != 0u) {
+                timer->expires = expires + timer->period;
+                wheel_add(timer);
+                g_armed++;
+            }
+            timer_account_slack(expires);
+            irq_restore(flags);
+            timer->fn(timer, timer->arg);
+            flags = irq_save_disable();
+        }
+    }
+    if (g_armed != 0u) {
+        g_next_expiry = wheel_next_event();
+    }
+    irq_restore(flags);
+}
+
+int timer_next_expiry(uint32_t *tick) {
+    if (g_armed == 0u) {
+        return 0;
+    }
+    *tick = g_next_expiry;
+    return 1;
+}
+
+void timer_get_stats(struct timer_stats *stats) {
+    uint32_t flags = irq_save_disable();
+
+    stats->armed = g_armed;
+    stats->fired = g_fired;
+    stats->cascaded = g_cascaded;
+    stats->slack_avg_ns = g_fired != 0u ? cpu_div64_32(g_slack_total_ns, g_fired, (uint32_t *)0) : 0u;
+    stats->slack_max_ns = g_slack_max_ns;
+    irq_restore(flags);
+}
+
+void timer_report(void) {
+    struct timer_stats stats;
+
+    timer_get_stats(&stats);
+    klogf(KLOG_INFO, "[timer] %u armed, %u fired, %u cascaded, slack avg %u ns, max %u ns", stats.armed, stats.fired,
+          stats.cascaded, stats.slack_avg_ns, stats.slack_max_ns);
+}
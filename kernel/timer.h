@@ -0,0 +1,63 @@
+#ifndef KERNEL_TIMER_H
+#define KERNEL_TIMER_H
+
+#include <stdint.h>
+
+struct timer;
+typedef void (*timer_fn)(struct timer *timer, void *arg);
+
+/*
+ * Software timer on a hierarchical tick wheel (4 levels x 64 slots, so
+ * 2^24 ticks of range; later expiries are re-filed when they come into
+ * range). Storage belongs to the caller; fields are private to
+ * kernel/timer.c. Arm and cancel are O(1) and IRQ-safe. Callbacks run from
+ * timer_run() in thread context with interrupts enabled, never from IRQ0.
+ */
+struct timer {
+    struct timer *next;
+    struct timer **pprev;
+    uint32_t expires;
+    uint32_t period;
+    uint16_t bucket;
+    timer_fn fn;
+    void *arg;
+};
+
+struct timer_stats {
+    uint32_t armed;
+    uint32_t fired;
+    /* Timers moved down from a coarser wheel level. */
+    uint32_t cascaded;
+    /* Callback start minus the start of its expiry tick. */
+    uint32_t slack_avg_ns;
+    uint32_t slack_max_ns;
+};
+
+void timer_setup(struct timer *timer, timer_fn fn, void *arg);
+/*
+ * (Re)arms `timer` `delay` ticks from now (0 runs it at the next
+ * timer_run()). A non-zero `period` re-arms it that many ticks after each
+ * expiry, measured from the expiry tick rather than from when the callback ran.
+ */
+void timer_arm(struct timer *timer, uint32_t delay, uint32_t period);
+/* Returns 1 if the timer was armed. A callback may cancel any timer, including itself. */
+int timer_cancel(struct timer *timer);
+int timer_armed(const struct timer *timer);
+/* Rounded up, so a timeout never fires early. */
+uint32_t timer_ms_to_ticks(uint32_t ms);
+
+/*
+ * IRQ0 hook: compares `tick` with the cached earliest expiry and flags
+ * timer_run(), so its cost does not grow with the number of armed timers.
+ */
+void timer_tick(uint32_t tick);
+int timer_pending(void);
+/* Advances the wheel to the current tick and runs every expired callback. */
+void timer_run(void);
+/* Earliest tick at which timer_run() may have work (a lower bound). Returns 0 if nothing is armed. */
+int timer_next_expiry(uint32_t *tick);
+
+void timer_get_stats(struct timer_stats *stats);
+void timer_report(void);
+
+#endif
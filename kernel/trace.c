@@ -0,0 +1,214 @@
+#include "kernel/trace.h"
+
+#include <stdint.h>
+
+#include "arch/x86/cpu.h"
+#include "arch/x86/irqflags.h"
+#include "arch/x86/pit.h"
+#include "drivers/serial.h"
+
+/* Power of two: sequence numbers run freely and are masked on access. */
+#define TRACE_BUFFER_EVENTS 2048u
+#define TRACE_BUFFER_MASK (TRACE_BUFFER_EVENTS - 1u)
+#define TRACE_STREAM_BATCH 64u
+#define TRACE_FRAME_VERSION 1u
+
+/* COM1's THRE interrupts are driven by the trace stream itself. */
+#define TRACE_DEFAULT_IRQ_MASK 0xFFEFu
+
+_Static_assert(sizeof(struct trace_event) == 20u, "trace record layout is part of the wire format");
+_Static_assert(sizeof(struct trace_frame_header) == 24u, "trace frame header layout is part of the wire format");
+
+static struct trace_event g_trace_buf[TRACE_BUFFER_EVENTS];
+static volatile uint32_t g_trace_next;
+static volatile int g_trace_enabled;
+static volatile uint16_t g_trace_irq_mask = TRACE_DEFAULT_IRQ_MASK;
+static int g_trace_use_tsc;
+static int g_trace_streaming;
+static uint32_t g_trace_stream_seq;
+static uint64_t g_trace_base_ts;
+static uint32_t g_trace_base_tick;
+
+static uint64_t trace_now(void) {
+    uint32_t hz;
+
+    if (g_trace_use_tsc != 0) {
+        return cpu_rdtsc();
+    }
+    hz = pit_get_frequency();
+    return hz != 0u ? (uint64_t)pit_get_ticks() * (1000u / hz) : 0u;
+}
+
+/* 64/32 division without libgcc; saturates instead of faulting on overflow. */
+static uint32_t trace_div64_32(uint64_t num, uint32_t den) {
+    uint32_t hi = (uint32_t)(num >> 32);
+    uint32_t quot;
+    uint32_t rem;
+
+    if (den == 0u || hi >= den) {
+        return 0xFFFFFFFFu;
+    }
+    __asm__("divl %4" : "=a"(quot), "=d"(rem) : "a"((uint32_t)num), "d"(hi), "rm"(den));
+    (void)rem;
+    return quot;
+}
+
+/* Timestamp units per millisecond, measured against the PIT since trace_init(). */
+static uint32_t trace_clock_khz(void) {
+    uint32_t hz;
+    uint32_t elapsed_ms;
+
+    if (g_trace_use_tsc == 0) {
+        return 1u;
+    }
+    hz = pit_get_frequency();
+    if (hz == 0u) {
+        return 0u;
+    }
+    elapsed_ms = (pit_get_ticks() - g_trace_base_tick) * (1000u / hz);
+    if (elapsed_ms == 0u) {
+        return 0u;
+    }
+    return trace_div64_32(cpu_rdtsc() - g_trace_base_ts, elapsed_ms);
+}
+
+void trace_init(void) {
+    g_trace_next = 0u;
+    g_trace_stream_seq = 0u;
+    g_trace_streaming = 0;
+    g_trace_irq_mask = TRACE_DEFAULT_IRQ_MASK;
+    g_trace_use_tsc = cpu_has_feature(CPU_FEATURE_TSC);
+    g_trace_base_tick = pit_get_ticks();
+    g_trace_base_ts = g_trace_use_tsc != 0 ? cpu_rdtsc() : 0u;
+    g_trace_enabled = 1;
+}
+
+void trace_set_enabled(int enabled) {
+    g_trace_enabled = enabled;
+}
+
+void trace_emit(uint16_t id, uint32_t arg0, uint32_t arg1) {
+    struct trace_event *ev;
+    uint64_t ts;
+    uint32_t seq;
+    uint32_t eflags;
+
+    if (g_trace_enabled == 0) {
+        return;
+    }
+
+    ts = trace_now();
+    __asm__ volatile("pushfl; popl %0" : "=r"(eflags));
+    /* lock xadd: nested IRQ producers each get their own slot. */
+    seq = __sync_fetch_and_add(&g_trace_next, 1u);
+    ev = &g_trace_buf[seq & TRACE_BUFFER_MASK];
+    ev->ts_lo = (uint32_t)ts;
+    ev->ts_hi = (uint32_t)(ts >> 32);
+    ev->id = id;
+    ev->flags = (eflags & EFLAGS_IF) != 0u ? 0u : TRACE_FLAG_IRQS_OFF;
+    ev->arg0 = arg0;
+    ev->arg1 = arg1;
+}
+
+void trace_set_irq_mask(uint16_t mask) {
+    g_trace_irq_mask = mask;
+}
+
+void trace_irq_enter(uint8_t irq_line, uint32_t eip) {
+    if ((g_trace_irq_mask & (1u << irq_line)) != 0u) {
+        trace_emit(TRACE_EV_IRQ_ENTER, irq_line, eip);
+    }
+}
+
+void trace_irq_exit(uint8_t irq_line) {
+    if ((g_trace_irq_mask & (1u << irq_line)) != 0u) {
+        trace_emit(TRACE_EV_IRQ_EXIT, irq_line, 0u);
+    }
+}
+
+static uint32_t trace_send(const void *data, uint32_t len) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t sum = 0u;
+    uint32_t i;
+
+    for (i = 0u; i < len; ++i) {
+        sum += bytes[i];
+    }
+    serial_write_raw(bytes, len);
+    return sum;
+}
+
+static void trace_send_frame(uint32_t first, uint32_t count, uint32_t lost) {
+    struct trace_frame_header header;
+    uint32_t sum = 0u;
+    uint32_t i;
+
+    header.magic[0] = 'T';
+    header.magic[1] = 'R';
+    header.magic[2] = 'C';
+    header.magic[3] = '1';
+    header.version = TRACE_FRAME_VERSION;
+    header.record_size = (uint16_t)sizeof(struct trace_event);
+    header.clock_khz = trace_clock_khz();
+    header.first_seq = first;
+    header.count = count;
+    header.lost = lost;
+    (void)trace_send(&header, sizeof(header));
+
+    for (i = 0u; i < count; ++i) {
+        sum += trace_send(&g_trace_buf[(first + i) & TRACE_BUFFER_MASK], sizeof(struct trace_event));
+    }
+
+    (void)trace_send("TEND", 4u);
+    (void)trace_send(&sum, sizeof(sum));
+}
+
+void trace_dump(void) {
+    uint32_t next;
+    uint32_t count;
+    int was_enabled;
+
+    /* Pause recording so the slow UART copy cannot be lapped by new events. */
+    was_enabled = g_trace_enabled;
+    g_trace_enabled = 0;
+    next = g_trace_next;
+    count = next < TRACE_BUFFER_EVENTS ? next : TRACE_BUFFER_EVENTS;
+    trace_send_frame(next - count, count, next - count);
+    serial_flush_sync();
+    g_trace_enabled = was_enabled;
+}
+
+void trace_set_streaming(int enabled) {
+    g_trace_streaming = enabled;
+    g_trace_stream_seq = g_trace_next;
+}
+
+void trace_poll(void) {
+    uint32_t next;
+    uint32_t first;
+    uint32_t lost;
+    uint32_t count;
+
+    if (g_trace_streaming == 0) {
+        return;
+    }
+
+    next = g_trace_next;
+    if (next - g_trace_stream_seq < TRACE_STREAM_BATCH) {
+        return;
+    }
+
+    first = g_trace_stream_seq;
+    lost = 0u;
+    if (next - first > TRACE_BUFFER_EVENTS) {
+        lost = next - first - TRACE_BUFFER_EVENTS;
+        first = next - TRACE_BUFFER_EVENTS;
+    }
+    count = next - first;
+    if (count > TRACE_STREAM_BATCH) {
+        count = TRACE_STREAM_BATCH;
+    }
+
+    trace_send_frame(first, count, lost);
+    g_trace_stream_seq = first + count;
+}
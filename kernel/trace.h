@@ -0,0 +1,61 @@
+#ifndef KERNEL_TRACE_H
+#define KERNEL_TRACE_H
+
+#include <stdint.h>
+
+/* Event ids; tools/trace2json.py mirrors this table. */
+#define TRACE_EV_IRQ_ENTER 1u    /* arg0 = IRQ line, arg1 = interrupted EIP */
+#define TRACE_EV_IRQ_EXIT 2u     /* arg0 = IRQ line */
+#define TRACE_EV_KBD_ENQUEUE 3u  /* arg0 = keyboard event, arg1 = queue depth */
+#define TRACE_EV_KBD_DEQUEUE 4u  /* arg0 = keyboard event, arg1 = queue depth */
+#define TRACE_EV_FFI_ENTER 5u    /* arg0 = FFI id (runtime/moon_kernel_ffi.c) */
+#define TRACE_EV_FFI_EXIT 6u     /* arg0 = FFI id, arg1 = return value */
+#define TRACE_EV_MARK 7u         /* arg0/arg1 = caller-defined */
+
+/* Event emitted with IRQs disabled (IRQ handler or critical section). */
+#define TRACE_FLAG_IRQS_OFF 0x0001u
+
+/*
+ * Fixed 20-byte record. `ts` is the TSC when available, otherwise PIT time in
+ * milliseconds; the frame header's clock_khz says which.
+ */
+struct trace_event {
+    uint32_t ts_lo;
+    uint32_t ts_hi;
+    uint16_t id;
+    uint16_t flags;
+    uint32_t arg0;
+    uint32_t arg1;
+};
+
+/*
+ * COM1 frame: "TRC1" header, `count` records, then "TEND" + a 32-bit byte sum
+ * of the records. Frames may be interleaved with ordinary text output.
+ */
+struct trace_frame_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t clock_khz;
+    uint32_t first_seq;
+    uint32_t count;
+    uint32_t lost;
+};
+
+void trace_init(void);
+void trace_set_enabled(int enabled);
+void trace_emit(uint16_t id, uint32_t arg0, uint32_t arg1);
+
+/* IRQ lines whose bit is clear are not traced. */
+void trace_set_irq_mask(uint16_t mask);
+void trace_irq_enter(uint8_t irq_line, uint32_t eip);
+void trace_irq_exit(uint8_t irq_line);
+
+/* Writes the whole buffer (newest TRACE_BUFFER_EVENTS records) as one frame. */
+void trace_dump(void);
+
+/* When streaming, trace_poll() sends new records in batches from the idle loop. */
+void trace_set_streaming(int enabled);
+void trace_poll(void);
+
+#endif
@@ -0,0 +1,653 @@
+#include "runtime/heap.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "drivers/serial.h"
+#include "kernel/fmt.h"
+#include "kernel/string.h"
+
+/*
+ * MoonBit runtime heap.
+ *
+ * The heap lives in the region handed to heap_set_region() at boot (the
+ * largest free Multiboot memory-map range), or in a small BSS bootstrap arena
+ * if no region was provided. The top of the heap only advances as allocations
+ * need it, so large regions cost nothing until used.
+ *
+ * Small requests (<= HEAP_SMALL_MAX payload bytes) are served from per-class
+ * slabs: each class keeps a LIFO free list of fixed-size chunks, so alloc and
+ * free are O(1). Slabs are carved out of the large-block heap and are never
+ * returned, which keeps steady-state churn at a flat footprint.
+ *
+ * Larger requests use boundary-tagged blocks kept in power-of-two bins.
+ * Freed blocks coalesce with free neighbours, and a free block that touches
+ * the untouched top of the heap is folded back into it.
+ */
+
+#define HEAP_BOOTSTRAP_SIZE (256 * 1024)
+#define ALLOC_ALIGN 8u
+
+#define HEAP_BLOCK_INUSE 0x1u
+#define HEAP_BLOCK_PREV_INUSE 0x2u
+#define HEAP_BLOCK_SMALL 0x4u
+#define HEAP_BLOCK_FLAGS 0x7u
+
+#define HEAP_SMALL_MAX 1024u
+#define HEAP_SMALL_CLASS_COUNT 14u
+#define HEAP_SLAB_BYTES 8192u
+#define HEAP_BIN_COUNT 32u
+#define HEAP_CALLSITE_SLOTS 64u
+
+/* Every block starts with this header; payload follows immediately. */
+struct alloc_header {
+    size_t size;  /* size requested by the caller (realloc copy length) */
+    size_t block; /* total block bytes including header, plus HEAP_BLOCK_* */
+};
+
+/* Links stored in the payload of free large blocks. */
+struct free_block {
+    struct alloc_header header;
+    struct free_block *next;
+    struct free_block *prev;
+};
+
+#define HEAP_MIN_LARGE_BLOCK \
+    ((sizeof(struct free_block) + sizeof(size_t) + (ALLOC_ALIGN - 1u)) & ~((size_t)(ALLOC_ALIGN - 1u)))
+
+static const uint16_t g_small_class_size[HEAP_SMALL_CLASS_COUNT] = {
+    8u, 16u, 24u, 32u, 48u, 64u, 96u, 128u, 192u, 256u, 384u, 512u, 768u, 1024u,
+};
+
+static union {
+    uint8_t bytes[HEAP_BOOTSTRAP_SIZE];
+    uintptr_t align;
+} heap_bootstrap;
+
+static uint8_t *g_region_base;
+static uint8_t *g_region_limit;
+static uint8_t *g_heap_base;
+static uint8_t *g_heap_top;
+static uint8_t *g_heap_limit;
+static int g_heap_ready;
+static struct heap_stats g_stats;
+static struct heap_callsite g_callsites[HEAP_CALLSITE_SLOTS];
+static int g_callsite_profiling;
+
+static uint8_t g_small_class_index[(HEAP_SMALL_MAX / ALLOC_ALIGN) + 1u];
+static struct alloc_header *g_small_free[HEAP_SMALL_CLASS_COUNT];
+static struct free_block *g_bins[HEAP_BIN_COUNT];
+
+static void heap_init(void) {
+    uint32_t cls;
+    uint32_t slot;
+
+    cls = 0u;
+    for (slot = 0u; slot <= HEAP_SMALL_MAX / ALLOC_ALIGN; ++slot) {
+        while (slot * ALLOC_ALIGN > g_small_class_size[cls]) {
+            ++cls;
+        }
+        g_small_class_index[slot] = (uint8_t)cls;
+    }
+
+    if (g_region_base != (uint8_t *)0) {
+        g_heap_base = g_region_base;
+        g_heap_limit = g_region_limit;
+    } else {
+        g_heap_base = &heap_bootstrap.bytes[0];
+        g_heap_limit = &heap_bootstrap.bytes[HEAP_BOOTSTRAP_SIZE];
+    }
+    g_heap_top = g_heap_base;
+    g_heap_ready = 1;
+}
+
+int heap_set_region(void *base, size_t size) {
+    uintptr_t start;
+    uintptr_t end;
+
+    /* Blocks already handed out from the bootstrap arena cannot be moved. */
+    if (g_heap_ready != 0) {
+        return 0;
+    }
+
+    start = (uintptr_t)base;
+    if (size > ((uintptr_t)-1) - start) {
+        size = ((uintptr_t)-1) - start;
+    }
+    end = (start + size) & ~((uintptr_t)(ALLOC_ALIGN - 1u));
+    start = (start + (ALLOC_ALIGN - 1u)) & ~((uintptr_t)(ALLOC_ALIGN - 1u));
+    if (end <= start || end - start < HEAP_SLAB_BYTES) {
+        return 0;
+    }
+
+    g_region_base = (uint8_t *)start;
+    g_region_limit = (uint8_t *)end;
+    return 1;
+}
+
+static size_t block_bytes(const struct alloc_header *header) {
+    return header->block & ~((size_t)HEAP_BLOCK_FLAGS);
+}
+
+static struct alloc_header *block_next(struct alloc_header *header) {
+    return (struct alloc_header *)(void *)((uint8_t *)header + block_bytes(header));
+}
+
+static void block_set_footer(struct alloc_header *header) {
+    size_t bytes = block_bytes(header);
+
+    *(size_t *)(void *)((uint8_t *)header + bytes - sizeof(size_t)) = bytes;
+}
+
+static uint32_t bin_index(size_t bytes) {
+    uint32_t index = 0u;
+
+    while (bytes > 1u && index < HEAP_BIN_COUNT - 1u) {
+        bytes >>= 1;
+        ++index;
+    }
+    return index;
+}
+
+static void bin_insert(struct free_block *block) {
+    uint32_t index = bin_index(block_bytes(&block->header));
+
+    block->prev = (struct free_block *)0;
+    block->next = g_bins[index];
+    if (block->next != (struct free_block *)0) {
+        block->next->prev = block;
+    }
+    g_bins[index] = block;
+}
+
+static void bin_remove(struct free_block *block) {
+    if (block->prev != (struct free_block *)0) {
+        block->prev->next = block->next;
+    } else {
+        g_bins[bin_index(block_bytes(&block->header))] = block->next;
+    }
+    if (block->next != (struct free_block *)0) {
+        block->next->prev = block->prev;
+    }
+}
+
+static struct free_block *bin_find(size_t bytes) {
+    uint32_t index;
+    struct free_block *block;
+
+    index = bin_index(bytes);
+    for (block = g_bins[index]; block != (struct free_block *)0; block = block->next) {
+        if (block_bytes(&block->header) >= bytes) {
+            return block;
+        }
+    }
+
+    /* Every block in a higher bin is at least twice the lower bound of this one. */
+    for (++index; index < HEAP_BIN_COUNT; ++index) {
+        if (g_bins[index] != (struct free_block *)0) {
+            return g_bins[index];
+        }
+    }
+    return (struct free_block *)0;
+}
+
+static void block_mark_prev_inuse(struct alloc_header *header, int inuse) {
+    struct alloc_header *next = block_next(header);
+
+    if ((uint8_t *)next >= g_heap_top) {
+        return;
+    }
+    if (inuse != 0) {
+        next->block |= HEAP_BLOCK_PREV_INUSE;
+    } else {
+        next->block &= ~((size_t)HEAP_BLOCK_PREV_INUSE);
+    }
+}
+
+/* Returns an in-use large block of exactly `bytes` (or a little more), or NULL. */
+static struct alloc_header *large_alloc(size_t bytes) {
+    struct free_block *block;
+    struct alloc_header *header;
+    struct alloc_header *rest;
+    size_t have;
+
+    if (bytes < HEAP_MIN_LARGE_BLOCK) {
+        bytes = HEAP_MIN_LARGE_BLOCK;
+    }
+
+    block = bin_find(bytes);
+    if (block != (struct free_block *)0) {
+        bin_remove(block);
+        header = &block->header;
+        have = block_bytes(header);
+
+        if (have - bytes >= HEAP_MIN_LARGE_BLOCK) {
+            rest = (struct alloc_header *)(void *)((uint8_t *)header + bytes);
+            rest->size = 0u;
+            rest->block = (have - bytes) | HEAP_BLOCK_PREV_INUSE;
+            block_set_footer(rest);
+            bin_insert((struct free_block *)(void *)rest);
+            have = bytes;
+        }
+
+        header->block = have | HEAP_BLOCK_INUSE | (header->block & HEAP_BLOCK_PREV_INUSE);
+        block_mark_prev_inuse(header, 1);
+        return header;
+    }
+
+    if (bytes > (size_t)(g_heap_limit - g_heap_top)) {
+        return (struct alloc_header *)0;
+    }
+
+    /* Free neighbours of the top are always folded into it, so PREV_INUSE holds. */
+    header = (struct alloc_header *)(void *)g_heap_top;
+    header->block = bytes | HEAP_BLOCK_INUSE | HEAP_BLOCK_PREV_INUSE;
+    g_heap_top += bytes;
+    return header;
+}
+
+static void large_free(struct alloc_header *header) {
+    struct alloc_header *next;
+    struct alloc_header *prev;
+    size_t bytes;
+
+    bytes = block_bytes(header);
+    next = block_next(header);
+    if ((uint8_t *)next < g_heap_top && (next->block & HEAP_BLOCK_INUSE) == 0u) {
+        bin_remove((struct free_block *)(void *)next);
+        bytes += block_bytes(next);
+    }
+
+    if ((header->block & HEAP_BLOCK_PREV_INUSE) == 0u) {
+        prev = (struct alloc_header *)(void *)((uint8_t *)header - *((size_t *)(void *)header - 1));
+        bin_remove((struct free_block *)(void *)prev);
+        bytes += block_bytes(prev);
+        header = prev;
+    }
+
+    if ((uint8_t *)header + bytes == g_heap_top) {
+        g_heap_top = (uint8_t *)header;
+        return;
+    }
+
+    header->size = 0u;
+    header->block = bytes | (header->block & HEAP_BLOCK_PREV_INUSE);
+    block_set_footer(header);
+    bin_insert((struct free_block *)(void *)header);
+    block_mark_prev_inuse(header, 0);
+}
+
+/*
+ * Resizes an in-use large block without moving it. Shrinking splits off the
+ * tail; growing absorbs a free successor or extends into the heap top.
+ */
+static int large_resize(struct alloc_header *header, size_t bytes) {
+    struct alloc_header *next;
+    struct alloc_header *rest;
+    size_t have;
+    size_t flags;
+
+    if (bytes < HEAP_MIN_LARGE_BLOCK) {
+        bytes = HEAP_MIN_LARGE_BLOCK;
+    }
+
+    have = block_bytes(header);
+    flags = header->block & HEAP_BLOCK_FLAGS;
+
+    if (bytes <= have) {
+        if (have - bytes >= HEAP_MIN_LARGE_BLOCK) {
+            header->block = bytes | flags;
+            rest = block_next(header);
+            rest->block = (have - bytes) | HEAP_BLOCK_INUSE | HEAP_BLOCK_PREV_INUSE;
+            large_free(rest);
+        }
+        return 1;
+    }
+
+    next = block_next(header);
+    if ((uint8_t *)next == g_heap_top) {
+        if (bytes - have > (size_t)(g_heap_limit - g_heap_top)) {
+            return 0;
+        }
+        g_heap_top += bytes - have;
+        header->block = bytes | flags;
+        return 1;
+    }
+
+    if ((next->block & HEAP_BLOCK_INUSE) != 0u || have + block_bytes(next) < bytes) {
+        return 0;
+    }
+
+    bin_remove((struct free_block *)(void *)next);
+    have += block_bytes(next);
+    if (have - bytes >= HEAP_MIN_LARGE_BLOCK) {
+        header->block = bytes | flags;
+        rest = block_next(header);
+        rest->size = 0u;
+        rest->block = (have - bytes) | HEAP_BLOCK_PREV_INUSE;
+        block_set_footer(rest);
+        bin_insert((struct free_block *)(void *)rest);
+    } else {
+        header->block = have | flags;
+        block_mark_prev_inuse(header, 1);
+    }
+    return 1;
+}
+
+static int small_refill(uint32_t cls) {
+    struct alloc_header *slab;
+    uint8_t *chunk;
+    uint8_t *end;
+    size_t chunk_bytes;
+
+    slab = large_alloc(HEAP_SLAB_BYTES);
+    if (slab == (struct alloc_header *)0) {
+        return 0;
+    }
+    slab->size = HEAP_SLAB_BYTES - sizeof(struct alloc_header);
+
+    chunk_bytes = sizeof(struct alloc_header) + g_small_class_size[cls];
+    chunk = (uint8_t *)(slab + 1);
+    end = (uint8_t *)slab + block_bytes(slab);
+    while (chunk + chunk_bytes <= end) {
+        struct alloc_header *header = (struct alloc_header *)(void *)chunk;
+
+        header->size = 0u;
+        header->block = chunk_bytes | HEAP_BLOCK_SMALL;
+        *(struct alloc_header **)(void *)(header + 1) = g_small_free[cls];
+        g_small_free[cls] = header;
+        chunk += chunk_bytes;
+    }
+    return 1;
+}
+
+static int heap_owns(const void *ptr) {
+    const uint8_t *p = (const uint8_t *)ptr;
+
+    return g_heap_ready != 0 && p >= g_heap_base + sizeof(struct alloc_header) && p < g_heap_top &&
+           ((uintptr_t)p & (ALLOC_ALIGN - 1u)) == 0u;
+}
+
+static uint32_t histogram_bucket(size_t size) {
+    uint32_t bucket = 31u - (uint32_t)__builtin_clz((uint32_t)size);
+
+    return bucket < HEAP_HISTOGRAM_BUCKETS ? bucket : HEAP_HISTOGRAM_BUCKETS - 1u;
+}
+
+static void stats_grow_live(size_t bytes) {
+    g_stats.live_bytes += (uint32_t)bytes;
+    if (g_stats.live_bytes > g_stats.peak_bytes) {
+        g_stats.peak_bytes = g_stats.live_bytes;
+    }
+}
+
+/* Open-addressed table keyed by return address; full tables drop new sites. */
+static void callsite_record(uintptr_t site, size_t size) {
+    uint32_t slot;
+    uint32_t probe;
+
+    slot = (uint32_t)((site >> 2) * 2654435761u) % HEAP_CALLSITE_SLOTS;
+    for (probe = 0u; probe < HEAP_CALLSITE_SLOTS; ++probe) {
+        struct heap_callsite *entry = &g_callsites[slot];
+
+        if (entry->site == site || entry->site == 0u) {
+            entry->site = site;
+            entry->count++;
+            entry->bytes += (uint32_t)size;
+            return;
+        }
+        slot = (slot + 1u) % HEAP_CALLSITE_SLOTS;
+    }
+}
+
+static void *heap_alloc(size_t size, uintptr_t site) {
+    size_t aligned;
+    size_t total;
+    struct alloc_header *header;
+    uint32_t cls;
+
+    if (g_heap_ready == 0) {
+        heap_init();
+    }
+
+    if (size == 0) {
+        size = 1;
+    }
+
+    if (size > ((size_t)-1) - (ALLOC_ALIGN - 1u)) {
+        g_stats.failed_allocs++;
+        return (void *)0;
+    }
+
+    aligned = (size + (ALLOC_ALIGN - 1u)) & ~((size_t)(ALLOC_ALIGN - 1u));
+    if (aligned > ((size_t)-1) - sizeof(struct alloc_header)) {
+        g_stats.failed_allocs++;
+        return (void *)0;
+    }
+
+    if (aligned <= HEAP_SMALL_MAX) {
+        cls = g_small_class_index[aligned / ALLOC_ALIGN];
+        if (g_small_free[cls] == (struct alloc_header *)0 && small_refill(cls) == 0) {
+            g_stats.failed_allocs++;
+            return (void *)0;
+        }
+        header = g_small_free[cls];
+        g_small_free[cls] = *(struct alloc_header **)(void *)(header + 1);
+        header->block |= HEAP_BLOCK_INUSE;
+    } else {
+        total = sizeof(struct alloc_header) + aligned;
+        header = large_alloc(total);
+        if (header == (struct alloc_header *)0) {
+            g_stats.failed_allocs++;
+            return (void *)0;
+        }
+    }
+
+    header->size = size;
+    g_stats.alloc_count++;
+    g_stats.size_histogram[histogram_bucket(size)]++;
+    stats_grow_live(size);
+    if (g_callsite_profiling != 0) {
+        callsite_record(site, size);
+    }
+    return (void *)(header + 1);
+}
+
+static void heap_release(void *ptr) {
+    struct alloc_header *header;
+    uint32_t cls;
+
+    if (ptr == (void *)0 || heap_owns(ptr) == 0) {
+        return;
+    }
+
+    header = ((struct alloc_header *)ptr) - 1;
+    if ((header->block & HEAP_BLOCK_INUSE) == 0u) {
+        /* Double free: the block is already on a free list. */
+        return;
+    }
+
+    g_stats.free_count++;
+    g_stats.live_bytes -= (uint32_t)header->size;
+
+    if ((header->block & HEAP_BLOCK_SMALL) != 0u) {
+        cls = g_small_class_index[(block_bytes(header) - sizeof(struct alloc_header)) / ALLOC_ALIGN];
+        header->block &= ~((size_t)HEAP_BLOCK_INUSE);
+        *(struct alloc_header **)ptr = g_small_free[cls];
+        g_small_free[cls] = header;
+        return;
+    }
+
+    large_free(header);
+}
+
+void *malloc(size_t size) {
+    return heap_alloc(size, (uintptr_t)__builtin_return_address(0));
+}
+
+void free(void *ptr) {
+    heap_release(ptr);
+}
+
+void *calloc(size_t count, size_t size) {
+    size_t total;
+    uint8_t *buf;
+
+    if (count != 0 && size > ((size_t)-1) / count) {
+        g_stats.failed_allocs++;
+        return (void *)0;
+    }
+    total = count * size;
+    buf = (uint8_t *)heap_alloc(total, (uintptr_t)__builtin_return_address(0));
+
+    if (buf == (uint8_t *)0) {
+        return (void *)0;
+    }
+
+    memset(buf, 0, total);
+    return buf;
+}
+
+void *realloc(void *ptr, size_t size) {
+    struct alloc_header *header;
+    void *new_ptr;
+    size_t old_size;
+    size_t copy_size;
+    size_t aligned;
+    uintptr_t site;
+
+    site = (uintptr_t)__builtin_return_address(0);
+    if (ptr == (void *)0) {
+        return heap_alloc(size, site);
+    }
+
+    if (size == 0) {
+        heap_release(ptr);
+        return (void *)0;
+    }
+
+    if (heap_owns(ptr) == 0) {
+        return (void *)0;
+    }
+
+    header = ((struct alloc_header *)ptr) - 1;
+    if ((header->block & HEAP_BLOCK_INUSE) == 0u) {
+        return (void *)0;
+    }
+
+    old_size = header->size;
+    if (size <= ((size_t)-1) - sizeof(struct alloc_header) - (ALLOC_ALIGN - 1u)) {
+        aligned = (size + (ALLOC_ALIGN - 1u)) & ~((size_t)(ALLOC_ALIGN - 1u));
+        if (((header->block & HEAP_BLOCK_SMALL) != 0u &&
+             aligned <= block_bytes(header) - sizeof(struct alloc_header)) ||
+            ((header->block & HEAP_BLOCK_SMALL) == 0u &&
+             large_resize(header, sizeof(struct alloc_header) + aligned) != 0)) {
+            /* A chunk keeps its class, so resizing within it is free. */
+            header->size = size;
+            g_stats.live_bytes -= (uint32_t)old_size;
+            stats_grow_live(size);
+            g_stats.realloc_in_place++;
+            return ptr;
+        }
+    }
+
+    new_ptr = heap_alloc(size, site);
+    if (new_ptr == (void *)0) {
+        return (void *)0;
+    }
+
+    copy_size = old_size < size ? old_size : size;
+    memcpy(new_ptr, ptr, copy_size);
+
+    heap_release(ptr);
+    g_stats.realloc_moved++;
+    return new_ptr;
+}
+
+void heap_get_realloc_counts(uint32_t *in_place, uint32_t *moved) {
+    if (in_place != (uint32_t *)0) {
+        *in_place = g_stats.realloc_in_place;
+    }
+    if (moved != (uint32_t *)0) {
+        *moved = g_stats.realloc_moved;
+    }
+}
+
+void heap_get_stats(struct heap_stats *out) {
+    if (out == (struct heap_stats *)0) {
+        return;
+    }
+
+    if (g_heap_ready == 0) {
+        heap_init();
+    }
+
+    *out = g_stats;
+    out->heap_bytes = (uint32_t)(g_heap_limit - g_heap_base);
+    out->carved_bytes = (uint32_t)(g_heap_top - g_heap_base);
+}
+
+void heap_set_callsite_profiling(int enabled) {
+    g_callsite_profiling = enabled != 0;
+}
+
+uint32_t heap_get_callsites(struct heap_callsite *out, uint32_t max) {
+    uint32_t slot;
+    uint32_t count = 0u;
+
+    for (slot = 0u; slot < HEAP_CALLSITE_SLOTS && count < max; ++slot) {
+        if (g_callsites[slot].site != 0u) {
+            out[count++] = g_callsites[slot];
+        }
+    }
+    return count;
+}
+
+static void heap_report_field(const char *label, uint32_t value) {
+    serial_puts(label);
+    put_hex32(value, serial_puts);
+    serial_puts("\n");
+}
+
+void heap_dump_stats(void) {
+    struct heap_stats stats;
+    uint32_t bucket;
+    uint32_t slot;
+
+    heap_get_stats(&stats);
+
+    serial_puts("[heap] stats\n");
+    heap_report_field("[heap]   heap bytes      ", stats.heap_bytes);
+    heap_report_field("[heap]   carved bytes    ", stats.carved_bytes);
+    heap_report_field("[heap]   live bytes      ", stats.live_bytes);
+    heap_report_field("[heap]   peak bytes      ", stats.peak_bytes);
+    heap_report_field("[heap]   allocs          ", stats.alloc_count);
+    heap_report_field("[heap]   frees           ", stats.free_count);
+    heap_report_field("[heap]   failed allocs   ", stats.failed_allocs);
+    heap_report_field("[heap]   realloc inplace ", stats.realloc_in_place);
+    heap_report_field("[heap]   realloc moved   ", stats.realloc_moved);
+
+    for (bucket = 0u; bucket < HEAP_HISTOGRAM_BUCKETS; ++bucket) {
+        if (stats.size_histogram[bucket] == 0u) {
+            continue;
+        }
+        serial_puts("[heap]   size >= ");
+        put_hex32(1u << bucket, serial_puts);
+        serial_puts(": ");
+        put_hex32(stats.size_histogram[bucket], serial_puts);
+        serial_puts("\n");
+    }
+
+    for (slot = 0u; slot < HEAP_CALLSITE_SLOTS; ++slot) {
+        if (g_callsites[slot].site == 0u) {
+            continue;
+        }
+        serial_puts("[heap]   site ");
+        put_hex32((uint32_t)g_callsites[slot].site, serial_puts);
+        serial_puts(" count=");
+        put_hex32(g_callsites[slot].count, serial_puts);
+        serial_puts(" bytes=");
+        put_hex32(g_callsites[slot].bytes, serial_puts);
+        serial_puts("\n");
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef RUNTIME_HEAP_H
+#define RUNTIME_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bucket i counts requests of [2^i, 2^(i+1)) bytes; the last bucket is open-ended. */
+#define HEAP_HISTOGRAM_BUCKETS 16u
+
+struct heap_stats {
+    uint32_t heap_bytes;   /* total heap capacity */
+    uint32_t carved_bytes; /* bytes between heap base and the current top */
+    uint32_t live_bytes;   /* requested bytes currently allocated */
+    uint32_t peak_bytes;   /* high-water mark of live_bytes */
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t failed_allocs;
+    uint32_t realloc_in_place;
+    uint32_t realloc_moved;
+    uint32_t size_histogram[HEAP_HISTOGRAM_BUCKETS];
+};
+
+struct heap_callsite {
+    uintptr_t site; /* return address of the malloc/calloc/realloc caller */
+    uint32_t count;
+    uint32_t bytes;
+};
+
+/*
+ * Places the heap in [base, base + size). Must run before the first
+ * allocation; returns 0 if the heap is already in use or the region is too
+ * small, in which case the built-in bootstrap arena is used.
+ */
+int heap_set_region(void *base, size_t size);
+
+void heap_get_stats(struct heap_stats *out);
+void heap_dump_stats(void);
+
+/* Number of reallocs resized in place vs. moved with a copy since boot. */
+void heap_get_realloc_counts(uint32_t *in_place, uint32_t *moved);
+
+/* Call-site recording is off by default; sites are symbolized offline with addr2line. */
+void heap_set_callsite_profiling(int enabled);
+uint32_t heap_get_callsites(struct heap_callsite *out, uint32_t max);
+
+#endif
@@ -1,51 +1,525 @@
+#include <stddef.h>
 #include <stdint.h>
 
+#include "arch/x86/cpu.h"
+#include "arch/x86/irq_stats.h"
 #include "arch/x86/keyboard.h"
 #include "arch/x86/pit.h"
 #include "drivers/serial.h"
 #include "drivers/vga.h"
+#include "kernel/clock.h"
+#include "kernel/klog.h"
+#include "kernel/kprintf.h"
+#include "kernel/numfmt.h"
+#include "kernel/profile.h"
+#include "kernel/string.h"
+#include "kernel/timer.h"
+#include "kernel/trace.h"
 #include "moonbit.h"
+#include "runtime/heap.h"
 
-static void write_bytes_to_serial(moonbit_bytes_t bytes) {
-    int32_t len;
-    int32_t i;
+/* FFI ids carried in TRACE_EV_FFI_* events; tools/trace2json.py mirrors them. */
+#define FFI_ID_SERIAL_PUTS 1u
+#define FFI_ID_VGA_PUTS 2u
+#define FFI_ID_GET_TICKS 3u
+#define FFI_ID_KEYBOARD_POP_EVENT 4u
+#define FFI_ID_HEAP_STATS 5u
+#define FFI_ID_HEAP_REPORT 6u
+#define FFI_ID_HEAP_PROFILE_CALLSITES 7u
+#define FFI_ID_KLOG_DRAIN 8u
+#define FFI_ID_KLOG_SET_LEVEL 9u
+#define FFI_ID_KLOG_DROPPED 10u
+#define FFI_ID_SERIAL_WRITE 11u
+#define FFI_ID_VGA_WRITE 12u
+#define FFI_ID_VGA_COMMIT 13u
+#define FFI_ID_KPRINTF 14u
+#define FFI_ID_FORMAT_INT 15u
+#define FFI_ID_FORMAT_INT64 16u
+#define FFI_ID_TIMER_ARM 17u
+#define FFI_ID_TIMER_CANCEL 18u
+#define FFI_ID_TIMER_POLL 19u
+#define FFI_ID_TIMER_STATS 20u
+#define FFI_ID_IRQ_STATS 21u
+#define FFI_ID_IRQ_OFF_STATS 22u
+#define FFI_ID_IRQ_STATS_DUMP 23u
+#define FFI_ID_PROFILE_START 24u
+#define FFI_ID_PROFILE_STOP 25u
+#define FFI_ID_PROFILE_DUMP 26u
+#define FFI_ID_PROFILE_SAMPLES 27u
+#define FFI_ID_KEYBOARD_POP_EVENTS 28u
+
+/* `mode` values for moon_kernel_format_int/_int64. */
+#define FFI_FORMAT_DEC 0
+#define FFI_FORMAT_UDEC 1
+#define FFI_FORMAT_HEX 2
+
+/*
+ * MoonBit timers: a fixed pool of wheel timers whose callbacks only count
+ * expiries; moon_kernel_timer_poll() hands them to MoonBit, which keeps the
+ * closures. Handles are slot | generation << 8 so a stale handle never
+ * matches a reused slot.
+ */
+#define FFI_TIMER_SLOTS 32u
+#define FFI_TIMER_SLOT_MASK 0xFFu
+#define FFI_TIMER_GENERATION_MASK 0x7FFFFFu
+
+struct ffi_timer {
+    struct timer timer;
+    uint32_t generation;
+    uint32_t pending;
+    int in_use;
+};
+
+static struct ffi_timer g_ffi_timers[FFI_TIMER_SLOTS];
+
+#define FFI_TRACE_ENTER(id) trace_emit(TRACE_EV_FFI_ENTER, (id), 0u)
+#define FFI_TRACE_EXIT(id, result) trace_emit(TRACE_EV_FFI_EXIT, (id), (uint32_t)(result))
+
+/*
+ * Validates [off, off + len) against the Bytes length and returns a pointer
+ * into the MoonBit buffer, or NULL for an empty or out-of-range slice.
+ */
+static const uint8_t *bytes_slice(moonbit_bytes_t bytes, int32_t off, int32_t len) {
+    int32_t total;
 
-    if (bytes == (moonbit_bytes_t)0) {
-        return;
+    if (bytes == (moonbit_bytes_t)0 || off < 0 || len <= 0) {
+        return (const uint8_t *)0;
     }
 
-    len = (int32_t)Moonbit_array_length(bytes);
-    for (i = 0; i < len; ++i) {
-        serial_putchar((char)bytes[i]);
+    total = (int32_t)Moonbit_array_length(bytes);
+    if (off > total || len > total - off) {
+        return (const uint8_t *)0;
+    }
+    return bytes + off;
+}
+
+void moon_kernel_serial_puts(moonbit_bytes_t s) {
+    FFI_TRACE_ENTER(FFI_ID_SERIAL_PUTS);
+    if (s != (moonbit_bytes_t)0) {
+        serial_write_raw(s, Moonbit_array_length(s));
+    }
+    FFI_TRACE_EXIT(FFI_ID_SERIAL_PUTS, 0);
+}
+
+void moon_kernel_vga_puts(moonbit_bytes_t s) {
+    FFI_TRACE_ENTER(FFI_ID_VGA_PUTS);
+    if (s != (moonbit_bytes_t)0) {
+        vga_write(s, Moonbit_array_length(s));
     }
+    FFI_TRACE_EXIT(FFI_ID_VGA_PUTS, 0);
 }
 
-static void write_bytes_to_vga(moonbit_bytes_t bytes) {
+/* Writes s[off, off + len) without copying; returns bytes written (0 if out of range). */
+int32_t moon_kernel_serial_write(moonbit_bytes_t s, int32_t off, int32_t len) {
+    const uint8_t *slice;
+
+    FFI_TRACE_ENTER(FFI_ID_SERIAL_WRITE);
+    slice = bytes_slice(s, off, len);
+    if (slice == (const uint8_t *)0) {
+        len = 0;
+    } else {
+        serial_write_raw(slice, (size_t)len);
+    }
+    FFI_TRACE_EXIT(FFI_ID_SERIAL_WRITE, len);
+    return len;
+}
+
+int32_t moon_kernel_vga_write(moonbit_bytes_t s, int32_t off, int32_t len) {
+    const uint8_t *slice;
+
+    FFI_TRACE_ENTER(FFI_ID_VGA_WRITE);
+    slice = bytes_slice(s, off, len);
+    if (slice == (const uint8_t *)0) {
+        len = 0;
+    } else {
+        vga_write(slice, (size_t)len);
+    }
+    FFI_TRACE_EXIT(FFI_ID_VGA_WRITE, len);
+    return len;
+}
+
+/*
+ * Formats `fmt` with `args` (ints only; %s prints "(?)") once and hands the
+ * result to every kprintf sink. Returns the untruncated length.
+ */
+int32_t moon_kernel_kprintf(moonbit_bytes_t fmt, int32_t *args) {
+    char buf[KPRINTF_BUF_SIZE];
     int32_t len;
-    int32_t i;
 
-    if (bytes == (moonbit_bytes_t)0) {
-        return;
+    FFI_TRACE_ENTER(FFI_ID_KPRINTF);
+    if (fmt == (moonbit_bytes_t)0) {
+        len = 0;
+    } else {
+        len = kformat_args(buf, sizeof(buf), (const char *)fmt, Moonbit_array_length(fmt), args,
+                           args != (int32_t *)0 ? Moonbit_array_length(args) : 0u);
+        kprintf_emit(buf, (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1u);
     }
+    FFI_TRACE_EXIT(FFI_ID_KPRINTF, len);
+    return len;
+}
 
-    len = (int32_t)Moonbit_array_length(bytes);
-    for (i = 0; i < len; ++i) {
-        vga_putchar((char)bytes[i]);
+/* Copies `len` formatted bytes into buf[off, ...) if they fit; returns len or 0. */
+static int32_t copy_into_bytes(moonbit_bytes_t buf, int32_t off, const char *text, size_t len) {
+    int32_t total;
+
+    if (buf == (moonbit_bytes_t)0 || off < 0) {
+        return 0;
+    }
+    total = (int32_t)Moonbit_array_length(buf);
+    if (off > total || (int32_t)len > total - off) {
+        return 0;
     }
+    memcpy(buf + off, text, len);
+    return (int32_t)len;
 }
 
-void moon_kernel_serial_puts(moonbit_bytes_t s) {
-    write_bytes_to_serial(s);
+/*
+ * Formats `value` into buf[off, ...) (mode: 0 signed decimal, 1 unsigned
+ * decimal, 2 lower-case hex). Returns the bytes written, 0 if they do not fit.
+ */
+int32_t moon_kernel_format_int(moonbit_bytes_t buf, int32_t off, int32_t value, int32_t mode) {
+    char text[NUMFMT_I32_DEC_MAX];
+    size_t len;
+    int32_t written;
+
+    FFI_TRACE_ENTER(FFI_ID_FORMAT_INT);
+    if (mode == FFI_FORMAT_HEX) {
+        len = numfmt_u32_hex(text, (uint32_t)value, 0);
+    } else if (mode == FFI_FORMAT_UDEC) {
+        len = numfmt_u32_dec(text, (uint32_t)value);
+    } else {
+        len = numfmt_i32_dec(text, value);
+    }
+    written = copy_into_bytes(buf, off, text, len);
+    FFI_TRACE_EXIT(FFI_ID_FORMAT_INT, written);
+    return written;
 }
 
-void moon_kernel_vga_puts(moonbit_bytes_t s) {
-    write_bytes_to_vga(s);
+int32_t moon_kernel_format_int64(moonbit_bytes_t buf, int32_t off, int64_t value, int32_t mode) {
+    char text[NUMFMT_U64_DEC_MAX];
+    size_t len;
+    int32_t written;
+
+    FFI_TRACE_ENTER(FFI_ID_FORMAT_INT64);
+    if (mode == FFI_FORMAT_HEX) {
+        len = numfmt_u64_hex(text, (uint64_t)value, 0);
+    } else if (mode == FFI_FORMAT_UDEC) {
+        len = numfmt_u64_dec(text, (uint64_t)value);
+    } else {
+        len = numfmt_i64_dec(text, value);
+    }
+    written = copy_into_bytes(buf, off, text, len);
+    FFI_TRACE_EXIT(FFI_ID_FORMAT_INT64, written);
+    return written;
+}
+
+void moon_kernel_vga_set_attr(int32_t attr) {
+    vga_set_attr((uint8_t)attr);
+}
+
+void moon_kernel_vga_commit(void) {
+    FFI_TRACE_ENTER(FFI_ID_VGA_COMMIT);
+    vga_commit();
+    FFI_TRACE_EXIT(FFI_ID_VGA_COMMIT, 0);
+}
+
+/* The clock reads are not traced: they exist to time hot paths and should cost one rdtsc. */
+int64_t moon_kernel_clock_ns(void) {
+    return (int64_t)clock_monotonic_ns();
+}
+
+int64_t moon_kernel_clock_cycles(void) {
+    return (int64_t)clock_cycles();
+}
+
+int64_t moon_kernel_cycles_to_ns(int64_t cycles) {
+    return cycles > 0 ? (int64_t)clock_cycles_to_ns((uint64_t)cycles) : 0;
 }
 
 int32_t moon_kernel_get_ticks(void) {
-    return (int32_t)pit_get_ticks();
+    int32_t ticks;
+
+    FFI_TRACE_ENTER(FFI_ID_GET_TICKS);
+    ticks = (int32_t)pit_get_ticks();
+    FFI_TRACE_EXIT(FFI_ID_GET_TICKS, ticks);
+    return ticks;
 }
 
 int32_t moon_kernel_keyboard_pop_event(void) {
-    return (int32_t)keyboard_pop_event();
+    int32_t event;
+
+    FFI_TRACE_ENTER(FFI_ID_KEYBOARD_POP_EVENT);
+    event = (int32_t)keyboard_pop_event();
+    FFI_TRACE_EXIT(FFI_ID_KEYBOARD_POP_EVENT, event);
+    return event;
+}
+
+/*
+ * Drains up to `max` ready key events (keyboard.h layout) into buf[] in one
+ * crossing, capped at Moonbit_array_length(buf); returns the count.
+ */
+int32_t moon_kernel_keyboard_pop_events(int32_t *buf, int32_t max) {
+    int32_t capacity;
+    int32_t count;
+
+    FFI_TRACE_ENTER(FFI_ID_KEYBOARD_POP_EVENTS);
+    capacity = buf != (int32_t *)0 ? (int32_t)Moonbit_array_length(buf) : 0;
+    if (max > capacity) {
+        max = capacity;
+    }
+    count = max > 0 ? (int32_t)keyboard_pop_events((uint32_t *)buf, (uint32_t)max) : 0;
+    FFI_TRACE_EXIT(FFI_ID_KEYBOARD_POP_EVENTS, count);
+    return count;
+}
+
+/* Copies up to Moonbit_array_length(out) of `fields`; returns how many were written. */
+static int32_t copy_fields(int32_t *out, const uint32_t *fields, int32_t count) {
+    int32_t len;
+    int32_t i;
+
+    len = out != (int32_t *)0 ? (int32_t)Moonbit_array_length(out) : 0;
+    if (len < count) {
+        count = len;
+    }
+    for (i = 0; i < count; ++i) {
+        out[i] = (int32_t)fields[i];
+    }
+    return count;
+}
+
+static int32_t copy_heap_stats(int32_t *out) {
+    struct heap_stats stats;
+
+    heap_get_stats(&stats);
+    return copy_fields(out, (const uint32_t *)(const void *)&stats, (int32_t)(sizeof(stats) / sizeof(uint32_t)));
+}
+
+int32_t moon_kernel_heap_stats(int32_t *out) {
+    int32_t count;
+
+    FFI_TRACE_ENTER(FFI_ID_HEAP_STATS);
+    count = copy_heap_stats(out);
+    FFI_TRACE_EXIT(FFI_ID_HEAP_STATS, count);
+    return count;
+}
+
+void moon_kernel_heap_report(void) {
+    FFI_TRACE_ENTER(FFI_ID_HEAP_REPORT);
+    heap_dump_stats();
+    FFI_TRACE_EXIT(FFI_ID_HEAP_REPORT, 0);
+}
+
+void moon_kernel_heap_profile_callsites(int32_t enabled) {
+    FFI_TRACE_ENTER(FFI_ID_HEAP_PROFILE_CALLSITES);
+    heap_set_callsite_profiling(enabled);
+    FFI_TRACE_EXIT(FFI_ID_HEAP_PROFILE_CALLSITES, 0);
+}
+
+void moon_kernel_klog_drain(void) {
+    FFI_TRACE_ENTER(FFI_ID_KLOG_DRAIN);
+    klog_drain();
+    FFI_TRACE_EXIT(FFI_ID_KLOG_DRAIN, 0);
+}
+
+void moon_kernel_klog_set_level(int32_t level) {
+    FFI_TRACE_ENTER(FFI_ID_KLOG_SET_LEVEL);
+    klog_set_level((int)level);
+    FFI_TRACE_EXIT(FFI_ID_KLOG_SET_LEVEL, 0);
+}
+
+int32_t moon_kernel_klog_dropped(void) {
+    int32_t dropped;
+
+    FFI_TRACE_ENTER(FFI_ID_KLOG_DROPPED);
+    dropped = (int32_t)klog_dropped();
+    FFI_TRACE_EXIT(FFI_ID_KLOG_DROPPED, dropped);
+    return dropped;
+}
+
+/* Markers and dumps are trace plumbing themselves, so they are not traced. */
+void moon_kernel_trace_mark(int32_t arg0, int32_t arg1) {
+    trace_emit(TRACE_EV_MARK, (uint32_t)arg0, (uint32_t)arg1);
+}
+
+void moon_kernel_trace_dump(void) {
+    trace_dump();
+}
+
+static int32_t ffi_timer_handle(uint32_t slot) {
+    return (int32_t)(slot | (g_ffi_timers[slot].generation << 8));
+}
+
+static struct ffi_timer *ffi_timer_lookup(int32_t handle) {
+    uint32_t slot = (uint32_t)handle & FFI_TIMER_SLOT_MASK;
+
+    if (handle < 0 || slot >= FFI_TIMER_SLOTS || g_ffi_timers[slot].in_use == 0 ||
+        ffi_timer_handle(slot) != handle) {
+        return (struct ffi_timer *)0;
+    }
+    return &g_ffi_timers[slot];
+}
+
+static void ffi_timer_release(struct ffi_timer *entry) {
+    entry->in_use = 0;
+    entry->pending = 0u;
+    entry->generation = (entry->generation + 1u) & FFI_TIMER_GENERATION_MASK;
+}
+
+static void ffi_timer_expired(struct timer *timer, void *arg) {
+    (void)timer;
+    ((struct ffi_timer *)arg)->pending++;
+}
+
+/* Arms a timer firing after delay_ms and then every period_ms (0: once); returns its handle or -1. */
+int32_t moon_kernel_timer_arm(int32_t delay_ms, int32_t period_ms) {
+    struct ffi_timer *entry;
+    uint32_t period;
+    uint32_t slot;
+    int32_t handle;
+
+    FFI_TRACE_ENTER(FFI_ID_TIMER_ARM);
+    handle = -1;
+    for (slot = 0u; slot < FFI_TIMER_SLOTS && delay_ms >= 0 && period_ms >= 0; ++slot) {
+        entry = &g_ffi_timers[slot];
+        if (entry->in_use == 0) {
+            entry->in_use = 1;
+            entry->pending = 0u;
+            period = period_ms > 0 ? timer_ms_to_ticks((uint32_t)period_ms) : 0u;
+            timer_setup(&entry->timer, ffi_timer_expired, entry);
+            timer_arm(&entry->timer, timer_ms_to_ticks((uint32_t)delay_ms), period);
+            handle = ffi_timer_handle(slot);
+            break;
+        }
+    }
+    FFI_TRACE_EXIT(FFI_ID_TIMER_ARM, handle);
+    return handle;
+}
+
+/* Returns 1 if `handle` was live; undelivered expiries are discarded. */
+int32_t moon_kernel_timer_cancel(int32_t handle) {
+    struct ffi_timer *entry;
+    int32_t ok;
+
+    FFI_TRACE_ENTER(FFI_ID_TIMER_CANCEL);
+    entry = ffi_timer_lookup(handle);
+    ok = entry != (struct ffi_timer *)0;
+    if (ok != 0) {
+        (void)timer_cancel(&entry->timer);
+        ffi_timer_release(entry);
+    }
+    FFI_TRACE_EXIT(FFI_ID_TIMER_CANCEL, ok);
+    return ok;
+}
+
+/*
+ * Runs due timers, then writes one handle per undelivered expiry into `out`;
+ * returns the count. A one-shot handle is dead once delivered. Expiries that
+ * do not fit stay queued for the next call.
+ */
+int32_t moon_kernel_timer_poll(int32_t *out) {
+    struct ffi_timer *entry;
+    int32_t capacity;
+    int32_t count;
+    uint32_t slot;
+
+    FFI_TRACE_ENTER(FFI_ID_TIMER_POLL);
+    timer_run();
+    capacity = out != (int32_t *)0 ? (int32_t)Moonbit_array_length(out) : 0;
+    count = 0;
+    for (slot = 0u; slot < FFI_TIMER_SLOTS; ++slot) {
+        entry = &g_ffi_timers[slot];
+        while (entry->in_use != 0 && entry->pending != 0u && count < capacity) {
+            entry->pending--;
+            out[count++] = ffi_timer_handle(slot);
+            if (entry->timer.period == 0u) {
+                ffi_timer_release(entry);
+            }
+        }
+    }
+    FFI_TRACE_EXIT(FFI_ID_TIMER_POLL, count);
+    return count;
+}
+
+/* Fills out[] with the struct timer_stats fields in order; returns how many were written. */
+int32_t moon_kernel_timer_stats(int32_t *out) {
+    struct timer_stats stats;
+    int32_t count;
+
+    FFI_TRACE_ENTER(FFI_ID_TIMER_STATS);
+    timer_get_stats(&stats);
+    count = copy_fields(out, (const uint32_t *)(const void *)&stats, (int32_t)(sizeof(stats) / sizeof(uint32_t)));
+    FFI_TRACE_EXIT(FFI_ID_TIMER_STATS, count);
+    return count;
+}
+
+/*
+ * Fills out[] with count, spurious, max cycles, average cycles and then the
+ * IRQ_STATS_BUCKETS histogram counts for `irq_line`; returns how many were
+ * written (0 for an unknown line).
+ */
+int32_t moon_kernel_irq_stats(int32_t irq_line, int32_t *out) {
+    struct irq_line_stats stats;
+    uint32_t fields[4u + IRQ_STATS_BUCKETS];
+    uint32_t i;
+    int32_t count;
+
+    FFI_TRACE_ENTER(FFI_ID_IRQ_STATS);
+    count = 0;
+    if (irq_line >= 0 && irq_line < (int32_t)IRQ_STATS_LINES && irq_stats_get_line((uint8_t)irq_line, &stats) != 0) {
+        fields[0] = stats.count;
+        fields[1] = stats.spurious;
+        fields[2] = stats.max_cycles;
+        fields[3] = stats.count != 0u ? cpu_div64_32(stats.total_cycles, stats.count, (uint32_t *)0) : 0u;
+        for (i = 0u; i < IRQ_STATS_BUCKETS; ++i) {
+            fields[4u + i] = stats.histogram[i];
+        }
+        count = copy_fields(out, fields, (int32_t)(sizeof(fields) / sizeof(fields[0])));
+    }
+    FFI_TRACE_EXIT(FFI_ID_IRQ_STATS, count);
+    return count;
+}
+
+/* Fills out[] with the struct irq_off_stats fields in order; returns how many were written. */
+int32_t moon_kernel_irq_off_stats(int32_t *out) {
+    struct irq_off_stats stats;
+    int32_t count;
+
+    FFI_TRACE_ENTER(FFI_ID_IRQ_OFF_STATS);
+    irq_stats_get_irqoff(&stats);
+    count = copy_fields(out, (const uint32_t *)(const void *)&stats, (int32_t)(sizeof(stats) / sizeof(uint32_t)));
+    FFI_TRACE_EXIT(FFI_ID_IRQ_OFF_STATS, count);
+    return count;
+}
+
+void moon_kernel_irq_stats_dump(void) {
+    FFI_TRACE_ENTER(FFI_ID_IRQ_STATS_DUMP);
+    irq_stats_dump();
+    FFI_TRACE_EXIT(FFI_ID_IRQ_STATS_DUMP, 0);
+}
+
+void moon_kernel_profile_start(int32_t hz) {
+    FFI_TRACE_ENTER(FFI_ID_PROFILE_START);
+    profile_start(hz > 0 ? (uint32_t)hz : 0u);
+    FFI_TRACE_EXIT(FFI_ID_PROFILE_START, 0);
+}
+
+void moon_kernel_profile_stop(void) {
+    FFI_TRACE_ENTER(FFI_ID_PROFILE_STOP);
+    profile_stop();
+    FFI_TRACE_EXIT(FFI_ID_PROFILE_STOP, 0);
+}
+
+void moon_kernel_profile_dump(void) {
+    FFI_TRACE_ENTER(FFI_ID_PROFILE_DUMP);
+    profile_dump();
+    FFI_TRACE_EXIT(FFI_ID_PROFILE_DUMP, 0);
+}
+
+int32_t moon_kernel_profile_samples(void) {
+    int32_t count;
+
+    FFI_TRACE_ENTER(FFI_ID_PROFILE_SAMPLES);
+    count = (int32_t)profile_sample_count();
+    FFI_TRACE_EXIT(FFI_ID_PROFILE_SAMPLES, count);
+    return count;
 }
@@ -8,6 +8,109 @@ void moon_kernel_vga_puts(uint8_t *s) {
     (void)s;
 }
 
+int32_t moon_kernel_serial_write(uint8_t *s, int32_t off, int32_t len) {
+    (void)s;
+    (void)off;
+    return len;
+}
+
+int32_t moon_kernel_vga_write(uint8_t *s, int32_t off, int32_t len) {
+    (void)s;
+    (void)off;
+    return len;
+}
+
+int32_t moon_kernel_kprintf(uint8_t *fmt, int32_t *args) {
+    (void)fmt;
+    (void)args;
+    return 0;
+}
+
+int32_t moon_kernel_format_int(uint8_t *buf, int32_t off, int32_t value, int32_t mode) {
+    (void)buf;
+    (void)off;
+    (void)value;
+    (void)mode;
+    return 0;
+}
+
+int32_t moon_kernel_format_int64(uint8_t *buf, int32_t off, int64_t value, int32_t mode) {
+    (void)buf;
+    (void)off;
+    (void)value;
+    (void)mode;
+    return 0;
+}
+
+void moon_kernel_vga_set_attr(int32_t attr) {
+    (void)attr;
+}
+
+void moon_kernel_vga_commit(void) {
+}
+
+int64_t moon_kernel_clock_ns(void) {
+    return 0;
+}
+
+int64_t moon_kernel_clock_cycles(void) {
+    return 0;
+}
+
+int64_t moon_kernel_cycles_to_ns(int64_t cycles) {
+    (void)cycles;
+    return 0;
+}
+
+int32_t moon_kernel_timer_arm(int32_t delay_ms, int32_t period_ms) {
+    (void)delay_ms;
+    (void)period_ms;
+    return -1;
+}
+
+int32_t moon_kernel_timer_cancel(int32_t handle) {
+    (void)handle;
+    return 0;
+}
+
+int32_t moon_kernel_timer_poll(int32_t *out) {
+    (void)out;
+    return 0;
+}
+
+int32_t moon_kernel_timer_stats(int32_t *out) {
+    (void)out;
+    return 0;
+}
+
+int32_t moon_kernel_irq_stats(int32_t irq_line, int32_t *out) {
+    (void)irq_line;
+    (void)out;
+    return 0;
+}
+
+int32_t moon_kernel_irq_off_stats(int32_t *out) {
+    (void)out;
+    return 0;
+}
+
+void moon_kernel_irq_stats_dump(void) {
+}
+
+void moon_kernel_profile_start(int32_t hz) {
+    (void)hz;
+}
+
+void moon_kernel_profile_stop(void) {
+}
+
+void moon_kernel_profile_dump(void) {
+}
+
+int32_t moon_kernel_profile_samples(void) {
+    return 0;
+}
+
 int32_t moon_kernel_get_ticks(void) {
     return 0;
 }
@@ -15,3 +118,40 @@ int32_t moon_kernel_get_ticks(void) {
 int32_t moon_kernel_keyboard_pop_event(void) {
     return 0;
 }
+
+int32_t moon_kernel_keyboard_pop_events(int32_t *buf, int32_t max) {
+    (void)buf;
+    (void)max;
+    return 0;
+}
+
+int32_t moon_kernel_heap_stats(int32_t *out) {
+    (void)out;
+    return 0;
+}
+
+void moon_kernel_heap_report(void) {
+}
+
+void moon_kernel_heap_profile_callsites(int32_t enabled) {
+    (void)enabled;
+}
+
+void moon_kernel_klog_drain(void) {
+}
+
+void moon_kernel_klog_set_level(int32_t level) {
+    (void)level;
+}
+
+int32_t moon_kernel_klog_dropped(void) {
+    return 0;
+}
+
+void moon_kernel_trace_mark(int32_t arg0, int32_t arg1) {
+    (void)arg0;
+    (void)arg1;
+}
+
+void moon_kernel_trace_dump(void) {
+}
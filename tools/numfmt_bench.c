@@ -0,0 +1,185 @@
+/*
+ * Host microbenchmark: kernel/numfmt.c against the per-digit formatting it
+ * replaces (put_hex32's nibble loop through a putchar callback, and a plain
+ * divide-by-10 loop for decimal). Also cross-checks every result against
+ * snprintf. Build and run with `make bench-numfmt`; add -m32 to
+ * BENCH_CFLAGS to exercise the i386 divl path.
+ */
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "kernel/numfmt.h"
+
+#define BENCH_VALUES 4096u
+#define BENCH_ROUNDS 2000u
+
+static char g_sink_buf[32];
+static size_t g_sink_len;
+static volatile uint32_t g_checksum;
+
+static void sink_putchar(char ch) {
+    g_sink_buf[g_sink_len++] = ch;
+}
+
+/* Called through a volatile pointer so the compiler cannot inline the sink away. */
+static void (*volatile g_putchar)(char) = sink_putchar;
+
+/* The old put_hex32 shape: one indirect call per nibble. */
+static __attribute__((noinline)) size_t old_hex32(char *buf, uint32_t value) {
+    static const char hex[] = "0123456789ABCDEF";
+    int shift;
+
+    g_sink_len = 0u;
+    g_putchar('0');
+    g_putchar('x');
+    for (shift = 28; shift >= 0; shift -= 4) {
+        g_putchar(hex[(value >> shift) & 0x0Fu]);
+    }
+    buf[g_sink_len - 1u] = g_sink_buf[g_sink_len - 1u];
+    return g_sink_len;
+}
+
+static __attribute__((noinline)) size_t old_u32_dec(char *buf, uint32_t value) {
+    char tmp[10];
+    size_t len = 0u;
+    size_t i;
+
+    do {
+        tmp[len++] = (char)('0' + value % 10u);
+        value /= 10u;
+    } while (value != 0u);
+    for (i = 0u; i < len; ++i) {
+        buf[i] = tmp[len - 1u - i];
+    }
+    return len;
+}
+
+static __attribute__((noinline)) size_t old_u64_dec(char *buf, uint64_t value) {
+    char tmp[20];
+    size_t len = 0u;
+    size_t i;
+
+    do {
+        tmp[len++] = (char)('0' + value % 10u);
+        value /= 10u;
+    } while (value != 0u);
+    for (i = 0u; i < len; ++i) {
+        buf[i] = tmp[len - 1u - i];
+    }
+    return len;
+}
+
+static __attribute__((noinline)) size_t new_hex32(char *buf, uint32_t value) {
+    buf[0] = '0';
+    buf[1] = 'x';
+    return 2u + numfmt_u32_hex(buf + 2, value, 1);
+}
+
+static uint64_t g_values[BENCH_VALUES];
+
+static uint64_t xorshift64(uint64_t *state) {
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Values spread over all digit counts: a random mantissa shifted right by a random amount. */
+static void fill_values(void) {
+    static const uint64_t edges[] = {0u, 9u, 10u, 99u, 100u, 999999999u, 1000000000u, 4294967295u, 4294967296u,
+                                     999999999999999999u, 1000000000000000000u, 9223372036854775808u,
+                                     18446744073709551615u};
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    uint32_t i;
+
+    for (i = 0u; i < BENCH_VALUES; ++i) {
+        g_values[i] = xorshift64(&state) >> (xorshift64(&state) % 64u);
+    }
+    memcpy(g_values, edges, sizeof(edges));
+}
+
+static int verify(void) {
+    char got[32];
+    char want[32];
+    size_t len;
+    uint32_t i;
+    int errors = 0;
+
+    for (i = 0u; i < BENCH_VALUES; ++i) {
+        uint64_t v = g_values[i];
+
+        len = numfmt_u64_dec(got, v);
+        got[len] = '\0';
+        snprintf(want, sizeof(want), "%" PRIu64, v);
+        errors += strcmp(got, want) != 0;
+
+        len = numfmt_i64_dec(got, (int64_t)v);
+        got[len] = '\0';
+        snprintf(want, sizeof(want), "%" PRId64, (int64_t)v);
+        errors += strcmp(got, want) != 0;
+
+        len = numfmt_u64_hex(got, v, 0);
+        got[len] = '\0';
+        snprintf(want, sizeof(want), "%" PRIx64, v);
+        errors += strcmp(got, want) != 0;
+
+        len = numfmt_i32_dec(got, (int32_t)v);
+        got[len] = '\0';
+        snprintf(want, sizeof(want), "%" PRId32, (int32_t)v);
+        errors += strcmp(got, want) != 0;
+
+        len = numfmt_u32_hex(got, (uint32_t)v, 1);
+        got[len] = '\0';
+        snprintf(want, sizeof(want), "%" PRIX32, (uint32_t)v);
+        errors += strcmp(got, want) != 0;
+    }
+    return errors;
+}
+
+#define BENCH(label, expr)                                                  \
+    do {                                                                    \
+        char buf[32] = {0};                                                 \
+        size_t len;                                                         \
+        uint32_t round;                                                     \
+        uint32_t i;                                                         \
+        uint32_t sum = 0u;                                                  \
+        double start = now_ns();                                            \
+        for (round = 0u; round < BENCH_ROUNDS; ++round) {                   \
+            for (i = 0u; i < BENCH_VALUES; ++i) {                           \
+                len = (expr);                                               \
+                sum += (uint32_t)len + (uint8_t)buf[len - 1u];              \
+            }                                                               \
+        }                                                                   \
+        g_checksum += sum;                                                  \
+        printf("%-28s %7.2f ns/op\n", label,                               \
+               (now_ns() - start) / ((double)BENCH_ROUNDS * BENCH_VALUES)); \
+    } while (0)
+
+int main(void) {
+    int errors;
+
+    fill_values();
+    errors = verify();
+    printf("verify: %d mismatches over %u values\n", errors, BENCH_VALUES);
+
+    BENCH("hex32 put_hex32 (old)", old_hex32(buf, (uint32_t)g_values[i]));
+    BENCH("hex32 numfmt", new_hex32(buf, (uint32_t)g_values[i]));
+    BENCH("u32 dec div-by-10 (old)", old_u32_dec(buf, (uint32_t)g_values[i]));
+    BENCH("u32 dec numfmt", numfmt_u32_dec(buf, (uint32_t)g_values[i]));
+    BENCH("u64 dec div-by-10 (old)", old_u64_dec(buf, g_values[i]));
+    BENCH("u64 dec numfmt", numfmt_u64_dec(buf, g_values[i]));
+    return errors != 0;
+}
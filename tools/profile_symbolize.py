@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Symbolize toy-os sampling profiler dumps (kernel/profile.c).
+
+Input is a COM1 log containing "[prof]" lines, e.g. from
+`make run-moon-kernel-profile` followed by F11 or MoonBit's profile_dump().
+Only the last complete dump is used. Prints a flat profile (self and
+inclusive samples per function) and optionally writes folded stacks for
+flamegraph.pl or https://www.speedscope.app.
+"""
+
+import argparse
+import bisect
+import collections
+import subprocess
+import sys
+
+PREFIX = "[prof] "
+
+
+def load_symbols(elf, nm):
+    """Sorted (address, name) pairs for the text symbols of `elf`."""
+    out = subprocess.run([nm, "-n", "--defined-only", elf], check=True, capture_output=True, text=True).stdout
+    symbols = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 3 or parts[1] not in "Tt":
+            continue
+        symbols.append((int(parts[0], 16), parts[2]))
+    return symbols
+
+
+class Symbolizer:
+    def __init__(self, symbols):
+        self.addrs = [addr for addr, _ in symbols]
+        self.names = [name for _, name in symbols]
+
+    def name(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return "0x%08x" % addr
+        return self.names[i]
+
+
+def parse_dump(lines):
+    """Returns (header fields, samples) of the last complete dump; each sample is [eip, ret0, ret1, ...]."""
+    header = None
+    samples = None
+    result = None
+    for raw in lines:
+        pos = raw.find(PREFIX)
+        if pos < 0:
+            continue
+        body = raw[pos + len(PREFIX):].strip()
+        if body.startswith("begin"):
+            header = dict(field.split("=", 1) for field in body.split()[1:] if "=" in field)
+            samples = []
+        elif body == "end":
+            if samples is not None:
+                result = (header, samples)
+            samples = None
+        elif samples is not None:
+            try:
+                samples.append([int(word, 16) for word in body.split()])
+            except ValueError:
+                continue
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="serial capture containing [prof] lines")
+    parser.add_argument("--elf", default="moon-kernel.elf", help="kernel image the samples came from")
+    parser.add_argument("--nm", default="nm", help="nm binary (e.g. i686-elf-nm)")
+    parser.add_argument("--folded", help="write folded stacks here ('-' for stdout)")
+    parser.add_argument("--top", type=int, default=25, help="rows in the flat profile")
+    args = parser.parse_args()
+
+    with open(args.log, "r", encoding="latin-1") as f:
+        dump = parse_dump(f)
+    if dump is None:
+        sys.exit("%s: no complete [prof] dump found" % args.log)
+    header, samples = dump
+    if not samples:
+        sys.exit("%s: the dump has no samples" % args.log)
+
+    sym = Symbolizer(load_symbols(args.elf, args.nm))
+    self_counts = collections.Counter()
+    total_counts = collections.Counter()
+    folded = collections.Counter()
+    for sample in samples:
+        # Return addresses point after the call; step back into it so a call at a function's end still resolves.
+        frames = [sym.name(sample[0])] + [sym.name(addr - 1) for addr in sample[1:]]
+        self_counts[frames[0]] += 1
+        for name in set(frames):
+            total_counts[name] += 1
+        folded[";".join(reversed(frames))] += 1
+
+    count = len(samples)
+    print("%d samples at %s Hz, %s dropped (%s)" % (count, header.get("hz", "?"), header.get("dropped", "?"), args.elf))
+    print("%7s %6s %7s %6s  %s" % ("self", "%", "total", "%", "function"))
+    # Callers with no self time still get a row for their inclusive share.
+    rows = sorted(total_counts, key=lambda name: (-self_counts[name], -total_counts[name], name))
+    for name in rows[:args.top]:
+        hits = self_counts[name]
+        print("%7d %5.1f%% %7d %5.1f%%  %s" % (hits, 100.0 * hits / count, total_counts[name],
+                                              100.0 * total_counts[name] / count, name))
+
+    if args.folded:
+        out = sys.stdout if args.folded == "-" else open(args.folded, "w", encoding="utf-8")
+        for stack, hits in sorted(folded.items()):
+            out.write("%s %d\n" % (stack, hits))
+        if out is not sys.stdout:
+            out.close()
+            print("folded stacks: %s" % args.folded)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Convert toy-os binary trace frames (kernel/trace.h) to Chrome trace JSON.
+
+Input is a raw COM1 capture, e.g. from `make run-moon-kernel-trace`; text log
+lines between frames are skipped. Open the output in chrome://tracing or
+https://ui.perfetto.dev.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"TRC1"
+TRAILER = b"TEND"
+HEADER = struct.Struct("<4sHHIIII")
+RECORD = struct.Struct("<IIHHII")
+
+# Mirrors kernel/trace.h.
+EV_IRQ_ENTER = 1
+EV_IRQ_EXIT = 2
+EV_KBD_ENQUEUE = 3
+EV_KBD_DEQUEUE = 4
+EV_FFI_ENTER = 5
+EV_FFI_EXIT = 6
+EV_MARK = 7
+FLAG_IRQS_OFF = 0x0001
+
+# Mirrors FFI_ID_* in runtime/moon_kernel_ffi.c.
+FFI_NAMES = {
+    1: "serial_puts",
+    2: "vga_puts",
+    3: "get_ticks",
+    4: "keyboard_pop_event",
+    5: "heap_stats",
+    6: "heap_report",
+    7: "heap_profile_callsites",
+    8: "klog_drain",
+    9: "klog_set_level",
+    10: "klog_dropped",
+    11: "serial_write",
+    12: "vga_write",
+    13: "vga_commit",
+    14: "kprintf",
+    15: "format_int",
+    16: "format_int64",
+    17: "timer_arm",
+    18: "timer_cancel",
+    19: "timer_poll",
+    20: "timer_stats",
+    21: "irq_stats",
+    22: "irq_off_stats",
+    23: "irq_stats_dump",
+    24: "profile_start",
+    25: "profile_stop",
+    26: "profile_dump",
+    27: "profile_samples",
+    28: "keyboard_pop_events",
+}
+
+IRQ_NAMES = {0: "PIT", 1: "keyboard", 4: "COM1"}
+
+
+def parse_frames(data):
+    """Yields (header, records) for every well-formed frame in `data`."""
+    pos = 0
+    while True:
+        pos = data.find(MAGIC, pos)
+        if pos < 0 or pos + HEADER.size > len(data):
+            return
+        magic, version, record_size, clock_khz, first_seq, count, lost = HEADER.unpack_from(data, pos)
+        body = pos + HEADER.size
+        end = body + count * record_size
+        if version != 1 or record_size != RECORD.size or end + 8 > len(data):
+            pos += 1
+            continue
+        trailer, checksum = struct.unpack_from("<4sI", data, end)
+        if trailer != TRAILER or (sum(data[body:end]) & 0xFFFFFFFF) != checksum:
+            sys.stderr.write("trace2json: dropping corrupt frame at offset %d\n" % pos)
+            pos += 1
+            continue
+        records = [RECORD.unpack_from(data, body + i * record_size) for i in range(count)]
+        header = {"clock_khz": clock_khz, "first_seq": first_seq, "count": count, "lost": lost}
+        yield header, records
+        pos = end + 8
+
+
+def irq_name(line):
+    return ("irq%d %s" % (line, IRQ_NAMES.get(line, ""))).rstrip()
+
+
+def to_chrome(frames):
+    events = []
+    seen = set()
+    base_ts = None
+    clock_khz = 0
+    lost_total = 0
+
+    for header, records in frames:
+        if header["clock_khz"] != 0:
+            clock_khz = header["clock_khz"]
+        lost_total += header["lost"]
+        for index, (ts_lo, ts_hi, ev_id, flags, arg0, arg1) in enumerate(records):
+            seq = header["first_seq"] + index
+            if seq in seen:
+                continue
+            seen.add(seq)
+            ts = (ts_hi << 32) | ts_lo
+            if base_ts is None:
+                base_ts = ts
+            event = {"pid": 1, "tid": 1, "ts": ts - base_ts, "args": {"seq": seq}}
+            if flags & FLAG_IRQS_OFF:
+                event["args"]["irqs_off"] = True
+
+            if ev_id == EV_IRQ_ENTER:
+                event.update(name=irq_name(arg0), cat="irq", ph="B")
+                event["args"]["eip"] = "0x%08x" % arg1
+            elif ev_id == EV_IRQ_EXIT:
+                event.update(name=irq_name(arg0), cat="irq", ph="E")
+            elif ev_id in (EV_FFI_ENTER, EV_FFI_EXIT):
+                name = FFI_NAMES.get(arg0, "ffi%d" % arg0)
+                event.update(name=name, cat="ffi", ph="B" if ev_id == EV_FFI_ENTER else "E")
+                if ev_id == EV_FFI_EXIT:
+                    event["args"]["result"] = arg1
+            elif ev_id in (EV_KBD_ENQUEUE, EV_KBD_DEQUEUE):
+                verb = "enqueue" if ev_id == EV_KBD_ENQUEUE else "dequeue"
+                event.update(name="kbd " + verb, cat="keyboard", ph="i", s="t")
+                event["args"].update(event="0x%08x" % arg0, depth=arg1)
+            elif ev_id == EV_MARK:
+                event.update(name="mark %d" % arg0, cat="mark", ph="i", s="g")
+                event["args"]["arg1"] = arg1
+            else:
+                event.update(name="event%d" % ev_id, cat="unknown", ph="i", s="t")
+                event["args"].update(arg0=arg0, arg1=arg1)
+            events.append(event)
+
+    # Chrome expects microseconds; clock_khz is timestamp units per millisecond.
+    scale = 1000.0 / clock_khz if clock_khz else 1.0
+    for event in events:
+        event["ts"] = event["ts"] * scale
+    events.sort(key=lambda e: (e["ts"], e["args"]["seq"]))
+
+    return {
+        "traceEvents": events,
+        "displayTimeUnit": "ns",
+        "otherData": {"clock_khz": clock_khz, "lost_events": lost_total},
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="raw COM1 capture containing TRC1 frames")
+    parser.add_argument("-o", "--output", default="-", help="output JSON path (default: stdout)")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as f:
+        data = f.read()
+
+    frames = list(parse_frames(data))
+    if not frames:
+        sys.stderr.write("trace2json: no TRC1 frames found in %s\n" % args.capture)
+        return 1
+
+    trace = to_chrome(frames)
+    if args.output == "-":
+        json.dump(trace, sys.stdout)
+    else:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+    sys.stderr.write("trace2json: %d frames, %d events, %d lost\n"
+                     % (len(frames), len(trace["traceEvents"]), trace["otherData"]["lost_events"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())